@@ -0,0 +1,166 @@
+#pragma once
+
+/*
+* Validating and decoding many Base58Check addresses at once.
+*
+* An address is 25 bytes: a version byte, a 20-byte hash, and a 4-byte checksum, which is the start of the double SHA-256
+* of the first 21 bytes. Both hashes fit in one block, with padding known in advance, so the checksums of LaneCount
+* addresses are computed together in lanes (see Lanes.h) straight from the decoded words, with no byte buffers.
+* The Base58 conversion itself is the chunked one from Base58Check.h. Large batches are split over threads.
+*/
+
+#include "Base58Check.h"
+#include "Lanes.h"
+
+#include <atomic>
+#include <chrono>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace AddressBatch
+{
+    struct Decoded
+    {
+        bool valid = false;
+        uint8_t version = 0;
+        ByteArray<20> payload = std::array<uint8_t, 20>{};
+    };
+
+    struct Statistics
+    {
+        uint64_t count = 0;
+        uint64_t validCount = 0;
+        double seconds = 0;
+
+        double AddressesPerSecond() const
+        {
+            return seconds > 0 ? count / seconds : 0;
+        }
+    };
+
+    // Validate and decode each of the encoded addresses into the corresponding entry of decoded, which must be the same size.
+    // Version and payload are set only for valid addresses and are left zeroed otherwise.
+    // threadCount = 0 uses all hardware threads.
+    Statistics Decode(std::span<const std::string_view> encoded, std::span<Decoded> decoded, unsigned threadCount = 0);
+}
+
+
+/* Implementation follows */
+
+namespace AddressBatch
+{
+namespace Detail
+{
+    constexpr size_t LaneCount = 8;
+    constexpr size_t AddressesPerChunk = 1 << 12;
+    constexpr size_t AddressBytes = 25;
+
+    // Decode LaneCount (or fewer) addresses and verify their checksums in lanes
+    inline void DecodeGroup(const std::string_view* encoded, Decoded* decoded, size_t count)
+    {
+        using namespace SHA256::Detail;
+        using Word = Lanes<LaneCount>;
+
+        // The 25 bytes of each address as big-endian words: the last is the checksum, the one before it holds a single byte
+        std::array<Word, 7> X;
+        std::array<bool, LaneCount> decodedOk = {};
+        for (size_t lane = 0; lane < count; ++lane)
+        {
+            decoded[lane] = Decoded();
+            std::array<uint8_t, Base58Check::MaxBytes> bytes;
+            size_t size = 0;
+            decodedOk[lane] = Base58Check::FromBase58(encoded[lane].data(), encoded[lane].size(), &bytes[0], bytes.size(), size) && size == AddressBytes;
+            if (!decodedOk[lane])
+                continue;
+            for (size_t k = 0; k < 5; ++k)
+                X[k].Set(lane, (uint32_t(bytes[4 * k]) << 24) | (uint32_t(bytes[4 * k + 1]) << 16) | (uint32_t(bytes[4 * k + 2]) << 8) | bytes[4 * k + 3]);
+            X[5].Set(lane, uint32_t(bytes[20]) << 24);
+            X[6].Set(lane, (uint32_t(bytes[21]) << 24) | (uint32_t(bytes[22]) << 16) | (uint32_t(bytes[23]) << 8) | bytes[24]);
+        }
+
+        // SHA-256 of the 21 bytes, then of the 32-byte digest: one block each
+        std::array<Word, 64> W;
+        std::array<Word, 8> H;
+        for (size_t k = 0; k < 5; ++k)
+            W[k] = X[k];
+        W[5] = X[5] | Word(0x00800000);
+        for (size_t k = 6; k < 15; ++k)
+            W[k] = 0;
+        W[15] = 21 * 8;
+        for (size_t i = 0; i < 8; ++i)
+            H[i] = s_initialHash[i];
+        Process16WordBlock(&W[0], W, H);
+
+        for (size_t i = 0; i < 8; ++i)
+            W[i] = H[i];
+        W[8] = 0x80000000;
+        for (size_t k = 9; k < 15; ++k)
+            W[k] = 0;
+        W[15] = 32 * 8;
+        for (size_t i = 0; i < 8; ++i)
+            H[i] = s_initialHash[i];
+        Process16WordBlock(&W[0], W, H);
+
+        // The checksum is the first four bytes of the digest, i.e. the first big-endian word
+        for (size_t lane = 0; lane < count; ++lane)
+        {
+            decoded[lane].valid = decodedOk[lane] && H[0][lane] == X[6][lane];
+            if (!decoded[lane].valid)
+                continue;
+            auto byteAt = [&](size_t j) { return static_cast<uint8_t>(X[j / 4][lane] >> (24 - 8 * (j % 4))); };
+            decoded[lane].version = byteAt(0);
+            for (size_t j = 0; j < 20; ++j)
+                decoded[lane].payload[j] = byteAt(j + 1);
+        }
+    }
+}
+
+inline Statistics Decode(std::span<const std::string_view> encoded, std::span<Decoded> decoded, unsigned threadCount)
+{
+    using namespace Detail;
+    if (decoded.size() != encoded.size())
+        throw std::invalid_argument("Output span must match the number of addresses");
+
+    const auto start = std::chrono::steady_clock::now();
+    std::atomic<size_t> nextChunk = 0;
+    std::atomic<uint64_t> validCount = 0;
+
+    auto worker = [&]()
+    {
+        uint64_t valid = 0;
+        while (true)
+        {
+            const size_t chunkBegin = nextChunk.fetch_add(AddressesPerChunk);
+            if (chunkBegin >= encoded.size())
+                break;
+            const size_t chunkEnd = std::min(chunkBegin + AddressesPerChunk, encoded.size());
+            for (size_t i = chunkBegin; i < chunkEnd; i += LaneCount)
+            {
+                const size_t count = std::min(LaneCount, chunkEnd - i);
+                DecodeGroup(&encoded[i], &decoded[i], count);
+                for (size_t lane = 0; lane < count; ++lane)
+                    valid += decoded[i + lane].valid;
+            }
+        }
+        validCount += valid;
+    };
+
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    const size_t chunkCount = (encoded.size() + AddressesPerChunk - 1) / AddressesPerChunk;
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < std::min<size_t>(threadCount, chunkCount); ++i)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& thread : threads)
+        thread.join();
+
+    Statistics statistics;
+    statistics.count = encoded.size();
+    statistics.validCount = validCount;
+    statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return statistics;
+}
+}
@@ -3,8 +3,12 @@
 #include "SHA256.h"
 #include "ByteArray.h"
 
+#include <cstdint>
+#include <initializer_list>
+#include <span>
+#include <stdexcept>
+#include <string>
 #include <vector>
-#include <stack>
 
 #include <iostream>
 
@@ -13,119 +17,243 @@ namespace Base58Check
 
     static constexpr std::array<char, 58> Base58Table =
     {
-        '1', '2', '3', '4', '5', '6', '7', '8', '9', 
+        '1', '2', '3', '4', '5', '6', '7', '8', '9',
         'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'J', 'K', 'L', 'M',
         'N', 'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z',
         'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'm',
         'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z'
     };
 
-    template <size_t N>
-    std::string Encode(const ByteArray<N>& payloadBytes, uint8_t version = 0x00)
+    // The longest byte string (including version and checksum) handled by the codec below.
+    // Longer than any Base58Check string in use, e.g. 25 for an address, 82 for an extended key.
+    static constexpr size_t MaxBytes = 128;
+
+    // An upper bound on the number of Base58 characters needed for a byte string of the given size
+    constexpr size_t MaxBase58Size(size_t sizeInBytes)
+    {
+        return sizeInBytes * 138 / 100 + 1; // log(256) / log(58) < 1.38
+    }
+
+    constexpr std::array<uint8_t, 256> GetReverseLUT()
+    {
+        std::array<uint8_t, 256> table = {};
+        for (auto& entry : table)
+            entry = 0xFF; // Not a Base58 character
+        for (uint8_t i = 0; i < static_cast<uint8_t>(Base58Table.size()); ++i)
+            table[static_cast<uint8_t>(Base58Table[i])] = i;
+        return table;
+    }
+
+    namespace Detail
     {
-        const auto bytesToEncode = version | payloadBytes;
-
-        const auto hash1 = ToBytesAsBigEndian(SHA256::Compute(bytesToEncode.begin(), bytesToEncode.end()));
-        const auto hash2 = ToBytesAsBigEndian(SHA256::Compute(hash1.begin(), hash1.end()));
-        auto inputWithChecksum = bytesToEncode | hash2.SubRange<0, 4>();
-        
-        // The number of Base58 characters in the result will be:
-        // the number of leading zero bytes in the bytes array, plus
-        // the number of Base58 characters to represent bytes = (N+5)*256/58, minus
-        // the number of leading zeros in the Base58 representation.
-        // i.e. it depends on the payload bytes
-        size_t leadingZeroBytes = 0;
-        while (leadingZeroBytes < inputWithChecksum.size() && inputWithChecksum[leadingZeroBytes] == 0)
-            ++leadingZeroBytes;
-
-        std::string base58Digits(leadingZeroBytes, Base58Table[0]);
-
-        // First perform the encoding allowing for leading zeros:
-        using Wide = UIntW<inputWithChecksum.size() * 8>;
-        Wide bigInt = inputWithChecksum.ToLittleEndianWords();
-        if (bigInt == 0)
-            return base58Digits;
-
-        std::stack<Wide> powerStack;
-        Wide powerOf58 = 1;
-        while (true)
+        // The conversion works five Base58 digits at a time: 58^5 is the largest power of 58 that fits in 32 bits,
+        // so each step is a 64-by-32-bit division or multiply-accumulate on one limb.
+        static constexpr uint32_t ChunkDigits = 5;
+        static constexpr uint32_t ChunkBase = 58 * 58 * 58 * 58 * 58;
+        static constexpr std::array<uint32_t, ChunkDigits + 1> PowersOf58 = { 1, 58, 58 * 58, 58 * 58 * 58, 58 * 58 * 58 * 58, ChunkBase };
+
+        static constexpr size_t MaxLimbs = MaxBytes / 4 + 1;
+
+        static constexpr auto ReverseLUT = GetReverseLUT();
+
+        // The first four bytes of the double SHA-256 of the concatenated pieces
+        inline ByteArray<4> Checksum(std::initializer_list<std::span<const uint8_t>> pieces)
         {
-            powerStack.push(powerOf58);
-            auto nextPower = powerOf58 * 58;
-            if (nextPower > bigInt)
-                break;
-            powerOf58 = nextPower;
+            const ByteArray<32> hash1 = ToBytesAsBigEndian(SHA256::Compute(pieces));
+            const uint32_t hash2 = SHA256::Compute(hash1.data(), hash1.size())[0];
+            return ByteArray<4>(static_cast<uint8_t>(hash2 >> 24), static_cast<uint8_t>(hash2 >> 16), static_cast<uint8_t>(hash2 >> 8), static_cast<uint8_t>(hash2));
         }
+    }
 
-        // Now bigInt <= 58^powerIndex
-        for (bool isLeading = true; bigInt > 0; powerStack.pop())
+    // Write the plain Base58 encoding (no checksum) of the concatenated pieces to out, which must have room for
+    // MaxBase58Size(total size) characters. Returns the number of characters written. Each leading zero byte becomes a leading '1'.
+    inline size_t ToBase58(std::span<const std::span<const uint8_t>> pieces, char* out)
+    {
+        using namespace Detail;
+        size_t sizeInBytes = 0;
+        for (const auto& piece : pieces)
+            sizeInBytes += piece.size();
+        if (sizeInBytes > MaxBytes)
+            throw std::invalid_argument("Byte string too long for Base58 encoding");
+
+        // Load the bytes after the leading zeros as a big-endian sequence of 32-bit limbs, the first of which may be partial
+        std::array<uint32_t, MaxLimbs> limbs = {};
+        size_t leadingZeroBytes = 0, limbCount = 0, byteIndex = 0, padding = 0;
+        for (const auto& piece : pieces)
+            for (const uint8_t byte : piece)
+            {
+                if (limbCount == 0 && byte == 0) // Still in the leading zeros
+                {
+                    ++leadingZeroBytes;
+                    continue;
+                }
+                if (limbCount == 0)
+                {
+                    const size_t significantBytes = sizeInBytes - leadingZeroBytes;
+                    limbCount = (significantBytes + 3) / 4;
+                    padding = (4 - significantBytes % 4) % 4;
+                }
+                const size_t slot = byteIndex++ + padding;
+                limbs[slot / 4] = (limbs[slot / 4] << 8) | byte;
+            }
+
+        // Repeatedly divide by 58^5, collecting the remainders least significant first
+        std::array<uint32_t, MaxBase58Size(MaxBytes) / ChunkDigits + 1> chunks;
+        size_t chunkCount = 0;
+        for (size_t first = 0; first < limbCount; )
         {
-            if (bigInt >= powerStack.top())
+            uint64_t remainder = 0;
+            for (size_t i = first; i < limbCount; ++i)
             {
-                auto qr = bigInt.DivideUnsignedQR(powerStack.top());
-                base58Digits.push_back(Base58Table[static_cast<uint32_t>(qr.first)]); // Write quotient as digit qr.first
-                bigInt = qr.second;
-                isLeading = false;
+                const uint64_t dividend = (remainder << 32) | limbs[i];
+                limbs[i] = static_cast<uint32_t>(dividend / ChunkBase);
+                remainder = dividend % ChunkBase;
             }
-            else if (!isLeading) // Write zero Base58 digit if it's not in a leading position
-                base58Digits.push_back(Base58Table[0]); 
+            chunks[chunkCount++] = static_cast<uint32_t>(remainder);
+            while (first < limbCount && limbs[first] == 0)
+                ++first;
+        }
+
+        // Write the chunks most significant first, without the leading zero digits of the first one
+        char* p = out;
+        for (size_t i = 0; i < leadingZeroBytes; ++i)
+            *p++ = Base58Table[0];
+        for (size_t i = chunkCount; i-- > 0; )
+        {
+            std::array<char, ChunkDigits> digits;
+            for (size_t k = ChunkDigits, chunk = chunks[i]; k-- > 0; chunk /= 58)
+                digits[k] = Base58Table[chunk % 58];
+            size_t skip = 0;
+            if (i == chunkCount - 1)
+                while (skip < ChunkDigits - 1 && digits[skip] == Base58Table[0])
+                    ++skip;
+            p = std::copy(digits.begin() + skip, digits.end(), p);
         }
-        return base58Digits;
+        return static_cast<size_t>(p - out);
     }
 
-    constexpr std::array<uint8_t, 256> GetReverseLUT()
+    inline size_t ToBase58(const uint8_t* bytes, size_t sizeInBytes, char* out)
     {
-        std::array<uint8_t, 256> table;
-        for (uint8_t i = 0; i < static_cast<uint8_t>(Base58Table.size()); ++i)
-            table[Base58Table[i]] = i;
-        return table;
+        const std::span<const uint8_t> piece(bytes, sizeInBytes);
+        return ToBase58({ &piece, 1 }, out);
     }
 
-    bool IsEncodingValid(const std::string& encodedString)
+    // Decode a plain Base58 string (no checksum) into out, which has room for capacity bytes.
+    // Returns false if the string contains a non-Base58 character or decodes to more than capacity bytes.
+    inline bool FromBase58(const char* encoded, size_t length, uint8_t* out, size_t capacity, size_t& sizeInBytes)
     {
-        static const auto reverseLUT = GetReverseLUT();
-        UIntW<200> sum = 0;
+        using namespace Detail;
+        if (length > MaxBase58Size(MaxBytes))
+            return false;
 
-        for (auto i = encodedString.begin(); i != encodedString.end(); ++i)
+        size_t leadingOnes = 0;
+        while (leadingOnes < length && encoded[leadingOnes] == Base58Table[0])
+            ++leadingOnes;
+
+        // Accumulate up to five digits at a time into little-endian 32-bit limbs: value = value * 58^k + chunk
+        std::array<uint32_t, MaxLimbs> limbs;
+        size_t limbCount = 0;
+        for (size_t i = leadingOnes; i < length; )
         {
-            sum *= 58;
-            if (*i != '1')
-                sum += reverseLUT[*i];
+            const size_t digitCount = std::min<size_t>(ChunkDigits, length - i);
+            uint32_t chunk = 0;
+            for (size_t k = 0; k < digitCount; ++k, ++i)
+            {
+                const uint8_t digit = ReverseLUT[static_cast<uint8_t>(encoded[i])];
+                if (digit == 0xFF)
+                    return false;
+                chunk = chunk * 58 + digit;
+            }
+
+            uint64_t carry = chunk;
+            for (size_t j = 0; j < limbCount; ++j)
+            {
+                carry += static_cast<uint64_t>(limbs[j]) * PowersOf58[digitCount];
+                limbs[j] = static_cast<uint32_t>(carry);
+                carry >>= 32;
+            }
+            if (carry != 0)
+                limbs[limbCount++] = static_cast<uint32_t>(carry);
         }
-        ByteArray<> inputWithChecksum(sum.beginBigEndianBytes(), sum.endBigEndianBytes());
-        if (inputWithChecksum.size() < 4)
+
+        size_t significantBytes = 4 * limbCount;
+        while (significantBytes > 0 && (limbs[(significantBytes - 1) / 4] >> (8 * ((significantBytes - 1) % 4))) == 0)
+            --significantBytes;
+        if (leadingOnes + significantBytes > capacity)
             return false;
-        const auto hash1 = ToBytesAsBigEndian(SHA256::Compute(inputWithChecksum.begin(), inputWithChecksum.end() - 4));
-        const auto hash2 = ToBytesAsBigEndian(SHA256::Compute(hash1.begin(), hash1.end()));
-        const auto checksum = hash2.SubRange<0, 4>();
-        const auto equal = std::equal(checksum.begin(), checksum.end(), inputWithChecksum.end() - 4);
-        return equal;
+
+        std::fill(out, out + leadingOnes, 0);
+        for (size_t i = 0; i < significantBytes; ++i)
+            out[leadingOnes + i] = static_cast<uint8_t>(limbs[(significantBytes - 1 - i) / 4] >> (8 * ((significantBytes - 1 - i) % 4)));
+        sizeInBytes = leadingOnes + significantBytes;
+        return true;
+    }
+
+    // Write the Base58Check encoding of the version byte followed by the payload to out,
+    // which must have room for MaxBase58Size(payload size + 5) characters. Returns the number of characters written.
+    // The version, payload and checksum are read in place, with no intermediate buffer.
+    inline size_t Encode(std::span<const uint8_t> payloadBytes, uint8_t version, char* out)
+    {
+        const std::span<const uint8_t> versionByte(&version, 1);
+        const auto checksum = Detail::Checksum({ versionByte, payloadBytes });
+        const std::array<std::span<const uint8_t>, 3> pieces = { versionByte, payloadBytes, checksum.Span() };
+        return ToBase58(pieces, out);
+    }
+
+    inline std::string Encode(std::span<const uint8_t> payloadBytes, uint8_t version = 0x00)
+    {
+        std::array<char, MaxBase58Size(MaxBytes)> encoded;
+        return std::string(encoded.data(), Encode(payloadBytes, version, encoded.data()));
     }
 
     template <size_t N>
-    ByteArray<N> Decode(const std::string& base58Check)
+    size_t Encode(const ByteArray<N>& payloadBytes, uint8_t version, char* out)
     {
-        static_assert(N > 0); // Need static size for sum until we have dynamically sized UIntW
-        static const auto reverseLUT = GetReverseLUT();
-        UIntW<N * 8> sum = 0;
+        return Encode(payloadBytes.Span(), version, out);
+    }
 
-        for (auto i = base58Check.begin(); i != base58Check.end(); ++i)
-        {
-            sum *= 58;
-            if (*i != '1')
-                sum += reverseLUT[*i];
-        }
-        ByteArray<N + 4> inputWithChecksum(sum.beginBigEndianBytes(), sum.endBigEndianBytes());
-        if (inputWithChecksum.size() < 4)
-            throw std::invalid_argument("Invalid Base58Check encoding");
-        ByteArray<N> rv(inputWithChecksum.size() - 4);
-        const auto hash1 = ToBytesAsBigEndian(SHA256::Compute(inputWithChecksum.begin(), inputWithChecksum.end() - 4));
-        const auto hash2 = ToBytesAsBigEndian(SHA256::Compute(hash1.begin(), hash1.end()));
-        const auto checksum = hash2.SubRange<0, 4>();
-        const auto equal = std::equal(checksum.begin(), checksum.end(), inputWithChecksum.end() - 4);
-        if (!equal)
+    template <size_t N>
+    std::string Encode(const ByteArray<N>& payloadBytes, uint8_t version = 0x00)
+    {
+        std::array<char, MaxBase58Size(N + 5)> encoded;
+        return std::string(encoded.data(), Encode(payloadBytes.Span(), version, encoded.data()));
+    }
+
+    // Decode a Base58Check string into out, which has room for capacity bytes, and verify its checksum.
+    // On success, sizeInBytes is the number of bytes written: the version byte and the payload, without the checksum.
+    inline bool Decode(const char* encoded, size_t length, uint8_t* out, size_t capacity, size_t& sizeInBytes)
+    {
+        std::array<uint8_t, MaxBytes> inputWithChecksum;
+        size_t size = 0;
+        if (!FromBase58(encoded, length, &inputWithChecksum[0], inputWithChecksum.size(), size) || size < 4 || size - 4 > capacity)
+            return false;
+        const auto checksum = Detail::Checksum({ std::span<const uint8_t>(inputWithChecksum.data(), size - 4) });
+        if (!std::equal(checksum.begin(), checksum.end(), inputWithChecksum.begin() + (size - 4)))
+            return false;
+        sizeInBytes = size - 4;
+        std::copy(inputWithChecksum.begin(), inputWithChecksum.begin() + sizeInBytes, out);
+        return true;
+    }
+
+    inline bool IsEncodingValid(const std::string& encodedString)
+    {
+        std::array<uint8_t, MaxBytes> decoded;
+        size_t size = 0;
+        return Decode(encodedString.data(), encodedString.size(), &decoded[0], decoded.size(), size);
+    }
+
+    // Decode a Base58Check string, returning (up to) the first N bytes of the version byte and payload
+    template <size_t N>
+    ByteArray<N> Decode(const std::string& base58Check)
+    {
+        static_assert(N > 0);
+        std::array<uint8_t, MaxBytes> decoded;
+        size_t size = 0;
+        if (!Decode(base58Check.data(), base58Check.size(), &decoded[0], decoded.size(), size))
             throw std::invalid_argument("Invalid Base58Check encoding");
-        std::copy(inputWithChecksum.begin(), std::min(inputWithChecksum.end(), inputWithChecksum.begin() + N), rv.begin());
+        ByteArray<N> rv;
+        std::fill(rv.begin(), rv.end(), 0);
+        std::copy(decoded.begin(), decoded.begin() + std::min(size, N), rv.begin());
         return rv;
     }
-}
\ No newline at end of file
+}
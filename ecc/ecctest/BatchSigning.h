@@ -0,0 +1,88 @@
+#pragma once
+
+/*
+* Signing many messages at once, with one private key for all or one per message.
+*
+* The messages are hashed eight at a time in lanes (see SHA256::ComputeBatch). The signatures then come from
+* EllipticCurve::SignBatch, where the nonce points come from the generator table and are made affine together,
+* and all the nonces are inverted together.
+* Signatures are written, in DER or compact form, to an output span allocated by the caller.
+*/
+
+#include "Bitcoin.h"
+
+#include <chrono>
+#include <span>
+#include <vector>
+
+namespace BatchSigning
+{
+    struct Statistics
+    {
+        uint64_t count = 0;
+        double seconds = 0;
+
+        double SignaturesPerSecond() const
+        {
+            return seconds > 0 ? count / seconds : 0;
+        }
+    };
+
+    // Sign messages[i] with privateKeys[0], or with privateKeys[i] if there is one key per message
+    template <typename Rnd>
+    Statistics Sign(std::span<const Bitcoin::PrivateKey> privateKeys, std::span<const std::span<const uint8_t>> messages, Rnd& rnd, std::span<Bitcoin::CompactSignature> signatures);
+
+    template <typename Rnd>
+    Statistics Sign(std::span<const Bitcoin::PrivateKey> privateKeys, std::span<const std::span<const uint8_t>> messages, Rnd& rnd, std::span<Bitcoin::Signature> signatures);
+}
+
+
+/* Implementation follows */
+
+namespace BatchSigning
+{
+namespace Detail
+{
+    template <typename Rnd>
+    std::vector<Bitcoin::EC::Signature> SignPairs(std::span<const Bitcoin::PrivateKey> privateKeys, std::span<const std::span<const uint8_t>> messages, Rnd& rnd)
+    {
+        std::vector<SHA256::Hash> hashes(messages.size());
+        SHA256::ComputeBatch(messages, hashes);
+        std::vector<Bitcoin::EC::Signature> pairs(messages.size());
+        Bitcoin::EC::SignBatch<8>(privateKeys, std::span<const SHA256::Hash>(hashes), rnd, std::span<Bitcoin::EC::Signature>(pairs));
+        return pairs;
+    }
+}
+
+template <typename Rnd>
+Statistics Sign(std::span<const Bitcoin::PrivateKey> privateKeys, std::span<const std::span<const uint8_t>> messages, Rnd& rnd, std::span<Bitcoin::CompactSignature> signatures)
+{
+    if (signatures.size() != messages.size())
+        throw std::invalid_argument("Output span must match the number of messages");
+    const auto start = std::chrono::steady_clock::now();
+    const auto pairs = Detail::SignPairs(privateKeys, messages, rnd);
+    for (size_t i = 0; i < pairs.size(); ++i)
+        signatures[i] = Compact::FromPair(pairs[i]);
+
+    Statistics statistics;
+    statistics.count = messages.size();
+    statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return statistics;
+}
+
+template <typename Rnd>
+Statistics Sign(std::span<const Bitcoin::PrivateKey> privateKeys, std::span<const std::span<const uint8_t>> messages, Rnd& rnd, std::span<Bitcoin::Signature> signatures)
+{
+    if (signatures.size() != messages.size())
+        throw std::invalid_argument("Output span must match the number of messages");
+    const auto start = std::chrono::steady_clock::now();
+    const auto pairs = Detail::SignPairs(privateKeys, messages, rnd);
+    for (size_t i = 0; i < pairs.size(); ++i)
+        signatures[i] = DER::EncodeSignature(pairs[i]);
+
+    Statistics statistics;
+    statistics.count = messages.size();
+    statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return statistics;
+}
+}
@@ -0,0 +1,354 @@
+#pragma once
+
+/*
+* Bech32 and Bech32m encoding (BIP 173 and BIP 350), and segwit addresses built on them.
+*
+* A Bech32 string is a human-readable part, the separator '1', then 5-bit data values written in a 32-character alphabet,
+* the last six of which are a checksum. The checksum is a BCH code evaluated by the "polymod" function over the expanded
+* human-readable part and the data. Bech32 and Bech32m differ only in the constant the polymod must come out to.
+*
+* The polymod steps through 5-bit values using a 32-entry table of generator combinations. For many strings at once,
+* eight polymods are interleaved so that their independent chains of lookups overlap.
+* Encoding writes into a caller's buffer of MaxLength characters, so nothing is allocated.
+*/
+
+#include "ByteArray.h"
+
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace Bech32
+{
+    enum class Encoding
+    {
+        Bech32,  // BIP 173, used for witness version 0
+        Bech32m  // BIP 350, used for witness versions 1 to 16
+    };
+
+    static constexpr size_t MaxLength = 90;
+
+    // Write the human-readable part, the separator, the 5-bit data values and the checksum to out, which must have room
+    // for MaxLength characters. The human-readable part must be lowercase. Returns the number of characters written.
+    size_t Encode(std::string_view hrp, const uint8_t* values, size_t valueCount, Encoding encoding, char* out);
+
+    // Decode and verify a Bech32 or Bech32m string. On success hrp refers to the human-readable part within encoded,
+    // the data values (without the checksum) are written to values, which must have room for MaxLength values,
+    // and encoding says which checksum was found.
+    bool Decode(std::string_view encoded, std::string_view& hrp, uint8_t* values, size_t& valueCount, Encoding& encoding);
+
+    // Segwit addresses: a witness version (0-16) and a witness program of 2-40 bytes.
+    // Version 0 programs are 20 bytes (P2WPKH) or 32 bytes (P2WSH) and use Bech32; later versions use Bech32m.
+    size_t EncodeSegwitAddress(std::string_view hrp, uint8_t witnessVersion, const uint8_t* program, size_t programSize, char* out);
+
+    template <size_t N>
+    std::string EncodeSegwitAddress(std::string_view hrp, uint8_t witnessVersion, const ByteArray<N>& program);
+
+    // program must have room for 40 bytes. hrp is compared case-insensitively.
+    bool DecodeSegwitAddress(std::string_view hrp, std::string_view address, uint8_t& witnessVersion, uint8_t* program, size_t& programSize);
+
+    struct DecodedAddress
+    {
+        bool valid = false;
+        uint8_t witnessVersion = 0;
+        uint8_t programSize = 0;
+        std::array<uint8_t, 40> program = {};
+    };
+
+    // DecodeSegwitAddress for many addresses, with the checksums of eight addresses at a time computed side by side
+    void DecodeSegwitAddresses(std::string_view hrp, std::span<const std::string_view> addresses, std::span<DecodedAddress> decoded);
+}
+
+
+/* Implementation follows */
+
+#include <algorithm>
+
+namespace Bech32
+{
+namespace Detail
+{
+    static constexpr std::array<char, 32> Charset =
+    {
+        'q', 'p', 'z', 'r', 'y', '9', 'x', '8', 'g', 'f', '2', 't', 'v', 'd', 'w', '0',
+        's', '3', 'j', 'n', '5', '4', 'k', 'h', 'c', 'e', '6', 'm', 'u', 'a', '7', 'l'
+    };
+
+    constexpr std::array<uint8_t, 256> GetReverseCharset()
+    {
+        std::array<uint8_t, 256> table = {};
+        for (auto& entry : table)
+            entry = 0xFF;
+        for (uint8_t i = 0; i < static_cast<uint8_t>(Charset.size()); ++i)
+        {
+            table[static_cast<uint8_t>(Charset[i])] = i;
+            if (Charset[i] >= 'a' && Charset[i] <= 'z')
+                table[static_cast<uint8_t>(Charset[i] - 'a' + 'A')] = i;
+        }
+        return table;
+    }
+
+    static constexpr auto ReverseCharset = GetReverseCharset();
+
+    static constexpr std::array<uint32_t, 5> Generator = { 0x3b6a57b2, 0x26508e6d, 0x1ea119fa, 0x3d4233dd, 0x2a1462b3 };
+
+    // The XOR of the generator terms selected by each combination of the five bits shifted out of the top
+    constexpr std::array<uint32_t, 32> GetGeneratorTable()
+    {
+        std::array<uint32_t, 32> table = {};
+        for (uint32_t top = 0; top < 32; ++top)
+            for (uint32_t i = 0; i < 5; ++i)
+                if ((top >> i) & 1)
+                    table[top] ^= Generator[i];
+        return table;
+    }
+
+    static constexpr auto GeneratorTable = GetGeneratorTable();
+
+    constexpr uint32_t ChecksumConstant(Encoding encoding)
+    {
+        return encoding == Encoding::Bech32 ? 1 : 0x2bc830a3;
+    }
+
+    // Feed one 5-bit value into the polymod
+    inline uint32_t PolymodStep(uint32_t c, uint32_t value)
+    {
+        return ((c & 0x1FFFFFF) << 5) ^ value ^ GeneratorTable[c >> 25];
+    }
+
+    inline uint32_t Polymod(const uint8_t* values, size_t valueCount)
+    {
+        uint32_t c = 1;
+        for (size_t i = 0; i < valueCount; ++i)
+            c = PolymodStep(c, values[i]);
+        return c;
+    }
+
+    // The checksum is computed over the human-readable part expanded to the high bits of each character, a zero,
+    // the low bits of each character, and then the data values
+    static constexpr size_t MaxExpandedLength = 2 * MaxLength;
+
+    // Check the structure and characters of a Bech32 string and expand it into the values that the polymod runs over,
+    // including the checksum. Returns false if the string is malformed.
+    inline bool Expand(std::string_view encoded, size_t& separator, std::array<uint8_t, MaxExpandedLength>& expanded, size_t& expandedCount)
+    {
+        if (encoded.size() > MaxLength)
+            return false;
+        separator = encoded.rfind('1');
+        if (separator == std::string_view::npos || separator == 0 || separator + 7 > encoded.size())
+            return false;
+
+        bool hasLower = false, hasUpper = false;
+        for (char ch : encoded)
+        {
+            if (ch < 33 || ch > 126)
+                return false;
+            hasLower |= ch >= 'a' && ch <= 'z';
+            hasUpper |= ch >= 'A' && ch <= 'Z';
+        }
+        if (hasLower && hasUpper)
+            return false;
+
+        expandedCount = 0;
+        for (size_t i = 0; i < separator; ++i)
+            expanded[expandedCount++] = static_cast<uint8_t>(std::tolower(encoded[i]) >> 5);
+        expanded[expandedCount++] = 0;
+        for (size_t i = 0; i < separator; ++i)
+            expanded[expandedCount++] = static_cast<uint8_t>(std::tolower(encoded[i]) & 31);
+        for (size_t i = separator + 1; i < encoded.size(); ++i)
+        {
+            const uint8_t value = ReverseCharset[static_cast<uint8_t>(encoded[i])];
+            if (value == 0xFF)
+                return false;
+            expanded[expandedCount++] = value;
+        }
+        return true;
+    }
+
+    inline bool EncodingFromResidue(uint32_t residue, Encoding& encoding)
+    {
+        if (residue == ChecksumConstant(Encoding::Bech32))
+            encoding = Encoding::Bech32;
+        else if (residue == ChecksumConstant(Encoding::Bech32m))
+            encoding = Encoding::Bech32m;
+        else
+            return false;
+        return true;
+    }
+
+    inline bool EqualIgnoringCase(std::string_view lhs, std::string_view rhs)
+    {
+        return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin(),
+            [](char x, char y) { return std::tolower(x) == std::tolower(y); });
+    }
+
+    // Regroup bits, e.g. 8-bit bytes into 5-bit values. When decoding (pad = false), leftover bits must be fewer than
+    // FromBits and all zero. Returns the number of values written, or SIZE_MAX if the input is invalid.
+    template <uint32_t FromBits, uint32_t ToBits, bool Pad>
+    inline size_t ConvertBits(const uint8_t* in, size_t inCount, uint8_t* out)
+    {
+        constexpr uint32_t mask = (1 << ToBits) - 1;
+        uint32_t accumulator = 0, bits = 0;
+        size_t outCount = 0;
+        for (size_t i = 0; i < inCount; ++i)
+        {
+            accumulator = (accumulator << FromBits) | in[i];
+            for (bits += FromBits; bits >= ToBits; )
+            {
+                bits -= ToBits;
+                out[outCount++] = static_cast<uint8_t>((accumulator >> bits) & mask);
+            }
+        }
+        if (Pad)
+        {
+            if (bits > 0)
+                out[outCount++] = static_cast<uint8_t>((accumulator << (ToBits - bits)) & mask);
+        }
+        else if (bits >= FromBits || ((accumulator << (ToBits - bits)) & mask) != 0)
+            return SIZE_MAX;
+        return outCount;
+    }
+
+    // Apply the segwit rules to the data values of a decoded string
+    inline bool ProgramFromValues(const uint8_t* values, size_t valueCount, Encoding encoding, uint8_t& witnessVersion, uint8_t* program, size_t& programSize)
+    {
+        if (valueCount < 1 || values[0] > 16)
+            return false;
+        witnessVersion = values[0];
+        if (encoding != (witnessVersion == 0 ? Encoding::Bech32 : Encoding::Bech32m))
+            return false;
+        if ((valueCount - 1) * 5 / 8 > 40)
+            return false;
+        programSize = ConvertBits<5, 8, false>(values + 1, valueCount - 1, program);
+        if (programSize == SIZE_MAX || programSize < 2 || programSize > 40)
+            return false;
+        return witnessVersion != 0 || programSize == 20 || programSize == 32;
+    }
+}
+
+inline size_t Encode(std::string_view hrp, const uint8_t* values, size_t valueCount, Encoding encoding, char* out)
+{
+    using namespace Detail;
+    if (hrp.empty() || hrp.size() + 1 + valueCount + 6 > MaxLength)
+        throw std::invalid_argument("Bech32 string too long");
+
+    std::array<uint8_t, MaxExpandedLength> expanded;
+    size_t expandedCount = 0;
+    for (char ch : hrp)
+        expanded[expandedCount++] = static_cast<uint8_t>(ch >> 5);
+    expanded[expandedCount++] = 0;
+    for (char ch : hrp)
+        expanded[expandedCount++] = static_cast<uint8_t>(ch & 31);
+    std::copy(values, values + valueCount, &expanded[expandedCount]);
+    expandedCount += valueCount;
+    std::fill(&expanded[expandedCount], &expanded[expandedCount] + 6, 0);
+    expandedCount += 6;
+    const uint32_t checksum = Polymod(&expanded[0], expandedCount) ^ ChecksumConstant(encoding);
+
+    char* p = std::copy(hrp.begin(), hrp.end(), out);
+    *p++ = '1';
+    for (size_t i = 0; i < valueCount; ++i)
+        *p++ = Charset[values[i]];
+    for (size_t i = 0; i < 6; ++i)
+        *p++ = Charset[(checksum >> (5 * (5 - i))) & 31];
+    return static_cast<size_t>(p - out);
+}
+
+inline bool Decode(std::string_view encoded, std::string_view& hrp, uint8_t* values, size_t& valueCount, Encoding& encoding)
+{
+    using namespace Detail;
+    std::array<uint8_t, MaxExpandedLength> expanded;
+    size_t separator = 0, expandedCount = 0;
+    if (!Expand(encoded, separator, expanded, expandedCount) || !EncodingFromResidue(Polymod(&expanded[0], expandedCount), encoding))
+        return false;
+    hrp = encoded.substr(0, separator);
+    valueCount = encoded.size() - separator - 1 - 6;
+    std::copy(&expanded[expandedCount - 6 - valueCount], &expanded[expandedCount - 6], values);
+    return true;
+}
+
+inline size_t EncodeSegwitAddress(std::string_view hrp, uint8_t witnessVersion, const uint8_t* program, size_t programSize, char* out)
+{
+    if (witnessVersion > 16 || programSize < 2 || programSize > 40 || (witnessVersion == 0 && programSize != 20 && programSize != 32))
+        throw std::invalid_argument("Invalid witness program");
+
+    std::array<uint8_t, 1 + (40 * 8 + 4) / 5> values;
+    values[0] = witnessVersion;
+    const size_t valueCount = 1 + Detail::ConvertBits<8, 5, true>(program, programSize, &values[1]);
+    return Encode(hrp, &values[0], valueCount, witnessVersion == 0 ? Encoding::Bech32 : Encoding::Bech32m, out);
+}
+
+template <size_t N>
+std::string EncodeSegwitAddress(std::string_view hrp, uint8_t witnessVersion, const ByteArray<N>& program)
+{
+    std::array<char, MaxLength> encoded;
+    return std::string(encoded.data(), EncodeSegwitAddress(hrp, witnessVersion, &*program.begin(), program.size(), encoded.data()));
+}
+
+inline bool DecodeSegwitAddress(std::string_view hrp, std::string_view address, uint8_t& witnessVersion, uint8_t* program, size_t& programSize)
+{
+    std::string_view decodedHrp;
+    std::array<uint8_t, MaxLength> values;
+    size_t valueCount = 0;
+    Encoding encoding;
+    return Decode(address, decodedHrp, &values[0], valueCount, encoding) && Detail::EqualIgnoringCase(hrp, decodedHrp) &&
+        Detail::ProgramFromValues(&values[0], valueCount, encoding, witnessVersion, program, programSize);
+}
+
+inline void DecodeSegwitAddresses(std::string_view hrp, std::span<const std::string_view> addresses, std::span<DecodedAddress> decoded)
+{
+    using namespace Detail;
+    constexpr size_t N = 8;
+    if (decoded.size() != addresses.size())
+        throw std::invalid_argument("Output span must match the number of addresses");
+
+    for (size_t first = 0; first < addresses.size(); first += N)
+    {
+        const size_t count = std::min(N, addresses.size() - first);
+
+        // Check and expand each string, then lay the values out lane by lane
+        std::array<std::array<uint8_t, MaxExpandedLength>, N> expanded;
+        std::array<size_t, N> expandedCount = {}, separator = {};
+        std::array<bool, N> ok = {};
+        size_t longest = 0;
+        for (size_t lane = 0; lane < count; ++lane)
+        {
+            ok[lane] = Expand(addresses[first + lane], separator[lane], expanded[lane], expandedCount[lane]) &&
+                EqualIgnoringCase(hrp, addresses[first + lane].substr(0, separator[lane]));
+            if (!ok[lane])
+                expandedCount[lane] = 0;
+            longest = std::max(longest, expandedCount[lane]);
+        }
+
+        // Run the polymods side by side. Each is a chain of dependent table lookups, but the chains are independent,
+        // so the processor overlaps them. Strings longer than the shortest (and a final partial group) finish one at a time.
+        std::array<uint32_t, N> c;
+        c.fill(1);
+        const size_t shortest = count == N ? *std::min_element(expandedCount.begin(), expandedCount.end()) : 0;
+        for (size_t i = 0; i < shortest; ++i)
+            for (size_t lane = 0; lane < N; ++lane)
+                c[lane] = PolymodStep(c[lane], expanded[lane][i]);
+        for (size_t lane = 0; lane < count; ++lane)
+            for (size_t i = shortest; i < expandedCount[lane]; ++i)
+                c[lane] = PolymodStep(c[lane], expanded[lane][i]);
+
+        for (size_t lane = 0; lane < count; ++lane)
+        {
+            auto& result = decoded[first + lane];
+            result = DecodedAddress();
+            Encoding encoding;
+            if (!ok[lane] || !EncodingFromResidue(c[lane], encoding))
+                continue;
+            const size_t valueCount = addresses[first + lane].size() - separator[lane] - 1 - 6;
+            size_t programSize = 0;
+            result.valid = ProgramFromValues(&expanded[lane][expandedCount[lane] - 6 - valueCount], valueCount, encoding,
+                result.witnessVersion, &result.program[0], programSize);
+            result.programSize = static_cast<uint8_t>(programSize);
+        }
+    }
+}
+}
@@ -3,8 +3,12 @@
 #include "secp256k1.h"
 #include "SHA256.h"
 #include "RIPEMD160.h"
+#include "Hash160.h"
 #include "Base58Check.h"
+#include "Bech32.h"
 #include "DER.h"
+#include "CompactSignature.h"
+#include "RFC6979.h"
 
 namespace Bitcoin
 {
@@ -14,7 +18,23 @@ namespace Bitcoin
     using LongHash = ByteArray<32>;
     using ShortHash = ByteArray<20>;
     using Address = std::string;
-    using Signature = ByteArray<>;
+    using Signature = DER::EncodedSignature<256>; // Inline storage, no allocation
+    using CompactSignature = Compact::Signature<256>; // Fixed 64 bytes, r || s
+    using PublicKeyTable = EC::Table; // Precomputed multiples of a public key, for keys that sign often
+    using PublicKeyCache = PointTableCache<EC>;
+
+    namespace Detail
+    {
+        // The message bytes of a contiguous range as a char pointer and size; an empty range gives { nullptr, 0 }
+        template <typename Iter> std::pair<const char*, size_t> MessageChars(Iter begin, Iter end)
+        {
+            if (!(begin < end))
+                return { nullptr, 0 };
+            const char* first = reinterpret_cast<const char*>(&begin[0]);
+            const char* last = reinterpret_cast<const char*>(&begin[0] + (end - begin));
+            return { first, static_cast<size_t>(last - first) };
+        }
+    }
 
     template <typename Iter> LongHash SHA256Hash(Iter begin, Iter end)
     {
@@ -38,6 +58,39 @@ namespace Bitcoin
         return SHA256Hash(hash1.begin(), hash1.end());
     }
 
+    // RIPEMD160(SHA256(serialized public key)), without going through the generic byte stream hashers
+    ShortHash PublicKeyHash(const PublicKey& publicKey, bool compressed = true)
+    {
+        return ToBytesAsLittleEndian(::Hash160::Compute(publicKey.x.Value(), publicKey.y.Value(), compressed));
+    }
+
+    // PublicKeyHash of many keys, eight at a time
+    void PublicKeyHashBatch(std::span<const PublicKey> publicKeys, std::span<ShortHash> hashes, bool compressed = true)
+    {
+        constexpr size_t N = 8;
+        if (hashes.size() < publicKeys.size())
+            throw std::invalid_argument("Output span too small");
+
+        size_t i = 0;
+        for (; i + N <= publicKeys.size(); i += N)
+        {
+            std::array<::Hash160::Coordinate, N> xValues, yValues;
+            std::array<const ::Hash160::Coordinate*, N> x, y;
+            for (size_t lane = 0; lane < N; ++lane)
+            {
+                xValues[lane] = publicKeys[i + lane].x.Value();
+                yValues[lane] = publicKeys[i + lane].y.Value();
+                x[lane] = &xValues[lane];
+                y[lane] = &yValues[lane];
+            }
+            const auto laneHashes = ::Hash160::ComputeLanes(x, y, compressed);
+            for (size_t lane = 0; lane < N; ++lane)
+                hashes[i + lane] = ToBytesAsLittleEndian(laneHashes[lane]);
+        }
+        for (; i < publicKeys.size(); ++i)
+            hashes[i] = PublicKeyHash(publicKeys[i], compressed);
+    }
+
     template <typename Rnd>
     PrivateKey GeneratePrivateKey(Rnd& rnd)
     {
@@ -46,33 +99,170 @@ namespace Bitcoin
 
     Address PublicKeyToAddress(const PublicKey& publicKey, uint8_t version = 0x00)
     {
-        const auto compressedPublicKey = publicKey.Compressed();
-        const auto hashOfCompressedPublicKey = DoubleHashShort(compressedPublicKey.begin(), compressedPublicKey.end());
-        return Base58Check::Encode(hashOfCompressedPublicKey, version);
+        return Base58Check::Encode(PublicKeyHash(publicKey), version);
+    }
+
+    // Native segwit P2WPKH address (BIP 173): witness version 0 and the 20-byte public key hash
+    Address PublicKeyToSegwitAddress(const PublicKey& publicKey, std::string_view hrp = "bc")
+    {
+        return Bech32::EncodeSegwitAddress(hrp, 0, PublicKeyHash(publicKey));
+    }
+
+    // Segwit address of a 32-byte witness program: a P2WSH script hash (version 0) or a P2TR output key (version 1, BIP 350)
+    Address SegwitAddress(const LongHash& program, uint8_t witnessVersion, std::string_view hrp = "bc")
+    {
+        return Bech32::EncodeSegwitAddress(hrp, witnessVersion, program);
     }
 
     std::string PrivateKeyToWalletImportFormat(const PrivateKey& privateKey)
     {
-        return Base58Check::Encode(ByteArray<32>(privateKey.beginBigEndianBytes(), privateKey.endBigEndianBytes()), 0x80);
+        std::array<uint8_t, 32> keyBytes;
+        privateKey.ToBigEndianBytes(keyBytes.data(), keyBytes.size());
+        return Base58Check::Encode(keyBytes, 0x80);
     }
 
     template <typename Iter, typename Rnd>
     Signature Sign(const PrivateKey& privateKey, Iter begin, Iter end, Rnd& rnd)
     {
-        const char* beginChar = (begin < end) ? reinterpret_cast<const char*>(&begin[0]) : nullptr;
-        const char* endChar = (begin < end) ? reinterpret_cast<const char*>(&begin[0] + (end - begin)) : nullptr;
-        const size_t sizeChars = static_cast<size_t>(endChar - beginChar);
-        const auto signature = EC::SignMessage(privateKey, beginChar, sizeChars, rnd, SHA256::Compute<const char*>);
+        const auto [message, size] = Detail::MessageChars(begin, end);
+        const auto signature = EC::SignMessage(privateKey, message, size, rnd, SHA256::Compute<const char*>);
         return DER::EncodeSignature(signature);
     }
 
+    template <typename Iter, typename Rnd>
+    CompactSignature SignCompact(const PrivateKey& privateKey, Iter begin, Iter end, Rnd& rnd)
+    {
+        const auto [message, size] = Detail::MessageChars(begin, end);
+        return Compact::FromPair(EC::SignMessage(privateKey, message, size, rnd, SHA256::Compute<const char*>));
+    }
+
+    // Sign a digest the caller has already computed, e.g. a sighash, without hashing again
+    template <typename Rnd>
+    Signature SignDigest(const PrivateKey& privateKey, std::span<const uint8_t, 32> digest, Rnd& rnd)
+    {
+        return DER::EncodeSignature(EC::SignDigest(privateKey, digest, rnd));
+    }
+
+    template <typename Rnd>
+    Signature SignDigest(const PrivateKey& privateKey, const LongHash& digest, Rnd& rnd)
+    {
+        return SignDigest(privateKey, digest.Span(), rnd);
+    }
+
+    template <typename Rnd>
+    CompactSignature SignDigestCompact(const PrivateKey& privateKey, std::span<const uint8_t, 32> digest, Rnd& rnd)
+    {
+        return Compact::FromPair(EC::SignDigest(privateKey, digest, rnd));
+    }
+
+    template <typename Rnd>
+    CompactSignature SignDigestCompact(const PrivateKey& privateKey, const LongHash& digest, Rnd& rnd)
+    {
+        return SignDigestCompact(privateKey, digest.Span(), rnd);
+    }
+
+    // As SignDigestCompact, also giving the recovery id (0 to 3) from which RecoverPublicKey finds the public key again,
+    // so a record of the signature needn't store the key
+    template <typename Rnd>
+    CompactSignature SignDigestRecoverable(const PrivateKey& privateKey, const LongHash& digest, Rnd& rnd, int& recoveryId)
+    {
+        return Compact::FromPair(EC::SignDigestRecoverable(privateKey, digest.Span(), rnd, recoveryId));
+    }
+
+    // The public key that made a compact signature of digest. Returns false if there is none.
+    bool TryRecoverPublicKey(const LongHash& digest, Compact::SignatureView<256> signature, int recoveryId, PublicKey& publicKey)
+    {
+        return EC::TryRecoverPublicKey(digest.Span(), signature.r(), signature.s(), recoveryId, publicKey);
+    }
+
+    // As TryRecoverPublicKey, throwing std::invalid_argument if there is no such key
+    PublicKey RecoverPublicKey(const LongHash& digest, Compact::SignatureView<256> signature, int recoveryId)
+    {
+        return EC::RecoverPublicKey(digest.Span(), signature.r(), signature.s(), recoveryId);
+    }
+
+    // Recover many public keys, sharing the inversions between them. publicKeys[i] is the point at infinity where recovery fails.
+    void RecoverPublicKeys(std::span<const LongHash> digests, std::span<const CompactSignature> signatures, std::span<const int> recoveryIds, std::span<PublicKey> publicKeys)
+    {
+        if (signatures.size() != digests.size())
+            throw std::invalid_argument("Expected one signature per digest");
+        std::vector<SHA256::Hash> hashes(digests.size());
+        std::vector<EC::Signature> pairs(digests.size());
+        for (size_t i = 0; i < digests.size(); ++i)
+        {
+            const uint8_t* bytes = digests[i].data();
+            for (size_t j = 0; j < hashes[i].size(); ++j, bytes += 4)
+                hashes[i][j] = (uint32_t(bytes[0]) << 24) | (uint32_t(bytes[1]) << 16) | (uint32_t(bytes[2]) << 8) | bytes[3];
+            pairs[i] = Compact::SignatureView<256>(signatures[i]).ToPair();
+        }
+        EC::RecoverPublicKeys(std::span<const SHA256::Hash>(hashes), std::span<const EC::Signature>(pairs), recoveryIds, publicKeys);
+    }
+
+    template <typename Iter>
+    bool Verify(const PublicKey& publicKey, Iter begin, Iter end, std::span<const uint8_t> signature)
+    {
+        const auto [message, size] = Detail::MessageChars(begin, end);
+        const auto decoded = DER::DecodeSignature<256>(signature);
+        return EC::VerifySignature(publicKey, decoded, message, size, SHA256::Compute<const char*>);
+    }
+
+    // Verify a compact signature in place, e.g. Compact::View<256>(records, i) into a flat array of records
+    template <typename Iter>
+    bool Verify(const PublicKey& publicKey, Iter begin, Iter end, Compact::SignatureView<256> signature)
+    {
+        const auto [message, size] = Detail::MessageChars(begin, end);
+        return EC::VerifySignature(publicKey, Compact::SignatureView<256>::Bytes(signature), message, size, SHA256::Compute<const char*>);
+    }
+
+    template <typename Iter>
+    bool Verify(const PublicKey& publicKey, Iter begin, Iter end, const CompactSignature& signature)
+    {
+        return Verify(publicKey, begin, end, Compact::SignatureView<256>(signature));
+    }
+
+    bool VerifyDigest(const PublicKey& publicKey, std::span<const uint8_t, 32> digest, std::span<const uint8_t> signature)
+    {
+        return EC::VerifyDigest(publicKey, DER::DecodeSignature<256>(signature), digest);
+    }
+
+    bool VerifyDigest(const PublicKey& publicKey, std::span<const uint8_t, 32> digest, Compact::SignatureView<256> signature)
+    {
+        return EC::VerifyDigest(publicKey, signature.ToPair(), digest);
+    }
+
+    bool VerifyDigest(const PublicKey& publicKey, const LongHash& digest, std::span<const uint8_t> signature)
+    {
+        return VerifyDigest(publicKey, digest.Span(), signature);
+    }
+
+    bool VerifyDigest(const PublicKey& publicKey, const LongHash& digest, Compact::SignatureView<256> signature)
+    {
+        return VerifyDigest(publicKey, digest.Span(), signature);
+    }
+
+    bool VerifyDigest(const PublicKey& publicKey, std::span<const uint8_t, 32> digest, const CompactSignature& signature)
+    {
+        return VerifyDigest(publicKey, digest, Compact::SignatureView<256>(signature));
+    }
+
+    bool VerifyDigest(const PublicKey& publicKey, const LongHash& digest, const CompactSignature& signature)
+    {
+        return VerifyDigest(publicKey, digest.Span(), Compact::SignatureView<256>(signature));
+    }
+
+    // Verify against the table of a hot key, e.g. auto table = cache.Get(publicKey); Verify(*table, begin, end, signature)
     template <typename Iter>
-    bool Verify(const PublicKey& publicKey, Iter begin, Iter end, const Signature& signature)
+    bool Verify(const PublicKeyTable& publicKeyTable, Iter begin, Iter end, std::span<const uint8_t> signature)
     {
-        const char* beginChar = (begin < end) ? reinterpret_cast<const char*>(&begin[0]) : nullptr;
-        const char* endChar = (begin < end) ? reinterpret_cast<const char*>(&begin[0] + (end - begin)) : nullptr;
-        const size_t sizeChars = static_cast<size_t>(endChar - beginChar);
+        const auto [message, size] = Detail::MessageChars(begin, end);
         const auto decoded = DER::DecodeSignature<256>(signature);
-        return EC::VerifySignature(publicKey, decoded, beginChar, sizeChars, SHA256::Compute<const char*>);
+        return EC::VerifySignature(publicKeyTable, decoded, message, size, SHA256::Compute<const char*>);
+    }
+
+    template <typename Iter>
+    bool Verify(const PublicKeyTable& publicKeyTable, Iter begin, Iter end, Compact::SignatureView<256> signature)
+    {
+        const auto [message, size] = Detail::MessageChars(begin, end);
+        return EC::VerifySignature(publicKeyTable, signature.ToPair(), message, size, SHA256::Compute<const char*>);
     }
-}
\ No newline at end of file
+}
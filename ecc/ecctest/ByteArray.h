@@ -3,6 +3,15 @@
 #include <array>
 #include <vector>
 #include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
 
 template <size_t N = 0>
 class ByteArray
@@ -15,7 +24,8 @@ public:
             throw std::runtime_error("Static array unexpectedly shorter than desired buffer");
     }
     constexpr ByteArray(const std::array<uint8_t, N>& arr) : bytes(arr) {}
-    template <typename... Args> constexpr ByteArray(Args... args) : bytes{ args... } {}
+    template <typename... Args> requires (std::is_convertible_v<Args, uint8_t> && ...)
+    constexpr ByteArray(Args... args) : bytes{ args... } {}
     template <typename Iter> constexpr ByteArray(Iter begin, Iter end)
     {
         std::copy(begin, end, bytes.begin());
@@ -26,7 +36,21 @@ public:
     constexpr auto end() const { return bytes.end(); }
     constexpr auto begin() { return bytes.begin(); }
     constexpr auto end() { return bytes.end(); }
+    constexpr const uint8_t* data() const { return bytes.data(); }
+    constexpr uint8_t* data() { return bytes.data(); }
 
+    // Non-owning views of the bytes, e.g. for hashing in pieces without concatenating them first
+    constexpr std::span<const uint8_t, N> Span() const { return bytes; }
+    constexpr std::span<uint8_t, N> Span() { return bytes; }
+
+    template <size_t Begin, size_t End>
+    constexpr std::span<const uint8_t, End - Begin> SubSpan() const
+    {
+        static_assert(Begin < End && End <= N);
+        return Span().template subspan<Begin, End - Begin>();
+    }
+
+    // A copy of the bytes in [Begin, End). Prefer SubSpan where a view will do.
     template <size_t Begin, size_t End>
     constexpr ByteArray<End - Begin> SubRange() const
     {
@@ -70,44 +94,177 @@ private:
     std::array<uint8_t, N> bytes;
 };
 
+// Where ByteArray<0> puts contents too long for its inline buffer. By default that is the heap, but a batch job
+// can install a ByteArena on its thread, making each allocation a pointer bump, then Reset the arena between batches.
+// Arrays allocated from an arena must not be used after it is Reset or destroyed.
+class ByteArena
+{
+public:
+    // The initial buffer is kept across Resets, so a batch that fits in it never touches the heap
+    explicit ByteArena(size_t initialSizeInBytes = 1 << 16)
+        : buffer(std::make_unique<std::byte[]>(initialSizeInBytes)), resource(buffer.get(), initialSizeInBytes) {}
+    ByteArena(const ByteArena&) = delete;
+    ByteArena& operator =(const ByteArena&) = delete;
+
+    // Release everything allocated from the arena at once
+    void Reset() { resource.release(); }
+
+    // Installs the arena for the current thread for the lifetime of the Scope
+    class Scope
+    {
+    public:
+        explicit Scope(ByteArena& arena) : previous(s_current) { s_current = &arena.resource; }
+        ~Scope() { s_current = previous; }
+        Scope(const Scope&) = delete;
+        Scope& operator =(const Scope&) = delete;
+
+    private:
+        std::pmr::memory_resource* previous;
+    };
+
+    static std::pmr::memory_resource* Current() { return s_current ? s_current : std::pmr::new_delete_resource(); }
+
+private:
+    std::unique_ptr<std::byte[]> buffer;
+    std::pmr::monotonic_buffer_resource resource;
+    static inline thread_local std::pmr::memory_resource* s_current = nullptr;
+};
+
+// A byte string of any length. Up to InlineCapacity bytes are stored in the object itself, which covers signatures,
+// hashes, keys and addresses without any allocation. Longer contents come from ByteArena::Current().
 template <>
 class ByteArray<0>
 {
 public:
+    static constexpr size_t InlineCapacity = 80;
+
     ByteArray() {}
-    ByteArray(size_t size) : bytes(size) {}
-    template <typename Iter> ByteArray(Iter begin, Iter end) : bytes(begin, end) {}
-    ByteArray(std::vector<uint8_t>&& rhs) : bytes(std::move(rhs)) {}
-    ByteArray(size_t size, uint8_t value) : bytes(size, value) {}
+    ByteArray(size_t size) : ByteArray(size, 0) {}
+    ByteArray(size_t size, uint8_t value)
+    {
+        Reserve(size);
+        std::fill(p, p + size, value);
+        count = size;
+    }
+    template <typename Iter> requires (!std::is_integral_v<Iter>)
+    ByteArray(Iter begin, Iter end)
+    {
+        Reserve(static_cast<size_t>(std::distance(begin, end)));
+        count = static_cast<size_t>(std::copy(begin, end, p) - p);
+    }
+    ByteArray(const std::vector<uint8_t>& rhs) : ByteArray(rhs.begin(), rhs.end()) {}
 
-    size_t size() const { return bytes.size(); }
-    auto begin() const { return bytes.begin(); }
-    auto end() const { return bytes.end(); }
-    auto begin() { return bytes.begin(); }
-    auto end() { return bytes.end(); }
+    ByteArray(const ByteArray& rhs) : ByteArray(rhs.begin(), rhs.end()) {}
+    ByteArray(ByteArray&& rhs) noexcept { MoveFrom(rhs); }
+    ~ByteArray() { Deallocate(); }
 
-    void push_back(uint8_t byte) { bytes.push_back(byte); }
+    ByteArray& operator =(const ByteArray& rhs)
+    {
+        if (this != &rhs)
+        {
+            count = 0;
+            Reserve(rhs.count);
+            count = static_cast<size_t>(std::copy(rhs.begin(), rhs.end(), p) - p);
+        }
+        return *this;
+    }
+
+    ByteArray& operator =(ByteArray&& rhs) noexcept
+    {
+        if (this != &rhs)
+        {
+            Deallocate();
+            MoveFrom(rhs);
+        }
+        return *this;
+    }
+
+    size_t size() const { return count; }
+    size_t capacity() const { return capacityInBytes; }
+    const uint8_t* begin() const { return p; }
+    const uint8_t* end() const { return p + count; }
+    uint8_t* begin() { return p; }
+    uint8_t* end() { return p + count; }
+    const uint8_t* data() const { return p; }
+    uint8_t* data() { return p; }
 
-    uint8_t operator [](size_t index) const { return bytes[index]; }
-    uint8_t& operator [](size_t index) { return bytes[index]; }
+    std::span<const uint8_t> Span() const { return { p, count }; }
+    std::span<uint8_t> Span() { return { p, count }; }
+    std::span<const uint8_t> SubSpan(size_t offset, size_t sizeInBytes) const { return Span().subspan(offset, sizeInBytes); }
+
+    void push_back(uint8_t byte)
+    {
+        if (count == capacityInBytes)
+            Reserve(2 * capacityInBytes);
+        p[count++] = byte;
+    }
+
+    uint8_t operator [](size_t index) const { return p[index]; }
+    uint8_t& operator [](size_t index) { return p[index]; }
 
     template <size_t  N>
     friend ByteArray operator |(const ByteArray& lhs, const ByteArray<N>& rhs)
     {
-        std::vector<uint8_t> rv(lhs.size() + rhs.size());
-        std::copy(lhs.begin(), lhs.end(), rv.begin());
-        std::copy(rhs.begin(), rhs.end(), rv.begin() + lhs.size());
+        ByteArray rv;
+        rv.Reserve(lhs.size() + rhs.size());
+        rv.count = static_cast<size_t>(std::copy(rhs.begin(), rhs.end(), std::copy(lhs.begin(), lhs.end(), rv.p)) - rv.p);
         return rv;
     }
 
     friend std::ostream& operator <<(std::ostream& os, const ByteArray& bytes)
     {
-        for (auto x : bytes.bytes)
+        for (auto x : bytes)
             os << std::hex << std::setw(2) << std::setfill('0') << +x;
         return os;
     }
+
 private:
-    std::vector<uint8_t> bytes;
+    // Ensure room for at least capacity bytes, keeping the current contents
+    void Reserve(size_t capacity)
+    {
+        if (capacity <= capacityInBytes)
+            return;
+        std::pmr::memory_resource* const newResource = ByteArena::Current();
+        uint8_t* const newBytes = static_cast<uint8_t*>(newResource->allocate(capacity, 1));
+        std::copy(p, p + count, newBytes);
+        Deallocate();
+        p = newBytes;
+        capacityInBytes = capacity;
+        resource = newResource;
+    }
+
+    void Deallocate()
+    {
+        if (resource != nullptr)
+            resource->deallocate(p, capacityInBytes, 1);
+        p = local.data();
+        capacityInBytes = InlineCapacity;
+        resource = nullptr;
+    }
+
+    // Take the allocation of rhs if it has one, otherwise copy its inline bytes. Leaves rhs empty.
+    void MoveFrom(ByteArray& rhs)
+    {
+        if (rhs.resource != nullptr)
+        {
+            p = rhs.p;
+            capacityInBytes = rhs.capacityInBytes;
+            resource = rhs.resource;
+            rhs.p = rhs.local.data();
+            rhs.capacityInBytes = InlineCapacity;
+            rhs.resource = nullptr;
+        }
+        else
+            std::copy(rhs.begin(), rhs.end(), local.begin());
+        count = rhs.count;
+        rhs.count = 0;
+    }
+
+    std::array<uint8_t, InlineCapacity> local;
+    uint8_t* p = local.data();
+    size_t count = 0;
+    size_t capacityInBytes = InlineCapacity;
+    std::pmr::memory_resource* resource = nullptr; // Null while the bytes are inline
 };
 
 // Convert an array of little-endian words to a byte array equivalent to big-endian words
@@ -0,0 +1,110 @@
+#pragma once
+
+/*
+* The compact form of an ECDSA signature: r then s, each as Bits / 8 big-endian bytes, 64 bytes for secp256k1.
+*
+* Unlike DER, every signature has the same size, so signatures can be stored as flat arrays of fixed-size records
+* (in memory or in a mapped file) and read in place through a SignatureView, with no parsing.
+* FromDER and ToDER convert whole batches between the two forms.
+*/
+
+#include "ByteArray.h"
+#include "DER.h"
+
+#include <span>
+
+namespace Compact
+{
+    template <size_t Bits> constexpr size_t ByteCount = 2 * (Bits / 8);
+
+    template <size_t Bits> using Signature = ByteArray<ByteCount<Bits>>;
+
+    // A read-only view of one compact signature, e.g. a record in a flat array. Does not own the bytes.
+    template <size_t Bits>
+    class SignatureView
+    {
+    public:
+        using Bytes = std::span<const uint8_t, ByteCount<Bits>>;
+
+        explicit SignatureView(const uint8_t* bytes) : bytes(bytes) {}
+        SignatureView(const Signature<Bits>& signature) : bytes(&*signature.begin()) {}
+
+        const uint8_t* data() const { return bytes; }
+        operator Bytes() const { return Bytes(bytes, ByteCount<Bits>); }
+
+        UIntW<Bits> r() const { return UIntW<Bits>::FromBigEndianBytes(bytes, Bits / 8); }
+        UIntW<Bits> s() const { return UIntW<Bits>::FromBigEndianBytes(bytes + Bits / 8, Bits / 8); }
+        DER::Signature<Bits> ToPair() const { return { r(), s() }; }
+
+    private:
+        const uint8_t* bytes;
+    };
+
+    template <size_t Bits>
+    Signature<Bits> FromPair(const DER::Signature<Bits>& rs);
+
+    // The index'th signature in a flat array of compact records
+    template <size_t Bits>
+    SignatureView<Bits> View(std::span<const uint8_t> records, size_t index);
+
+    // Convert each DER signature to compact form. valid[i] is false (and compact[i] zero) where the DER encoding
+    // is invalid, or where r or s is zero. Returns the number of valid signatures.
+    template <size_t Bits>
+    size_t FromDER(std::span<const std::span<const uint8_t>> encoded, std::span<Signature<Bits>> compact, std::span<bool> valid);
+
+    // Convert each compact signature to its DER encoding
+    template <size_t Bits>
+    void ToDER(std::span<const Signature<Bits>> compact, std::span<DER::EncodedSignature<Bits>> encoded);
+}
+
+
+/* Implementation follows */
+
+namespace Compact
+{
+template <size_t Bits>
+Signature<Bits> FromPair(const DER::Signature<Bits>& rs)
+{
+    Signature<Bits> compact;
+    rs.first.ToBigEndianBytes(&*compact.begin(), Bits / 8);
+    rs.second.ToBigEndianBytes(&*compact.begin() + Bits / 8, Bits / 8);
+    return compact;
+}
+
+template <size_t Bits>
+SignatureView<Bits> View(std::span<const uint8_t> records, size_t index)
+{
+    if ((index + 1) * ByteCount<Bits> > records.size())
+        throw std::out_of_range("Compact signature index out of range");
+    return SignatureView<Bits>(records.data() + index * ByteCount<Bits>);
+}
+
+template <size_t Bits>
+size_t FromDER(std::span<const std::span<const uint8_t>> encoded, std::span<Signature<Bits>> compact, std::span<bool> valid)
+{
+    if (compact.size() != encoded.size() || valid.size() != encoded.size())
+        throw std::invalid_argument("Output spans must match the number of signatures");
+
+    size_t validCount = 0;
+    for (size_t i = 0; i < encoded.size(); ++i)
+    {
+        DER::Signature<Bits> rs;
+        valid[i] = DER::TryDecodeSignature(encoded[i], rs) && !rs.first.IsZero() && !rs.second.IsZero();
+        if (valid[i])
+            compact[i] = FromPair(rs);
+        else
+            std::fill(compact[i].begin(), compact[i].end(), 0);
+        validCount += valid[i];
+    }
+    return validCount;
+}
+
+template <size_t Bits>
+void ToDER(std::span<const Signature<Bits>> compact, std::span<DER::EncodedSignature<Bits>> encoded)
+{
+    if (encoded.size() != compact.size())
+        throw std::invalid_argument("Output span must match the number of signatures");
+    for (size_t i = 0; i < compact.size(); ++i)
+        encoded[i] = DER::EncodeSignature(SignatureView<Bits>(compact[i]).ToPair());
+}
+}
@@ -1,58 +1,96 @@
 #pragma once
 
 /*
-* ASN.1 is a notation for structured data, and DER is a set of rules for transforming a 
+* ASN.1 is a notation for structured data, and DER is a set of rules for transforming a
 * data structure (described in ASN.1) into a sequence of bytes, and back.
-* 
+*
 * An ECDSA signature has the following ASN.1 description:
 
 ECDSASignature ::= SEQUENCE {
     r   INTEGER,
     s   INTEGER
 }
+
+* Encoded signatures are held inline in an EncodedSignature, so encoding and decoding never allocate.
+* Decoding is strict, as in BIP 66: every length is checked against the buffer, and only the minimal encoding is accepted.
 */
 
 #include "Wide.h"
 
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
 #include <span>
-#include <vector>
+#include <stdexcept>
 
 namespace DER
 {
     template <size_t Bits> using Signature = std::pair<UIntW<Bits>, UIntW<Bits>>;
-    using ByteStream = std::vector<uint8_t>;
+
+    // The longest encoding: two integers with a sign byte each, plus the tags and lengths. 72 bytes for 256-bit signatures.
+    template <size_t Bits> constexpr size_t MaxEncodedByteCount = 6 + 2 * (Bits / 8 + 1);
+
+    // A DER encoded signature, stored inline with a capacity of MaxEncodedByteCount<Bits> bytes
+    template <size_t Bits>
+    class EncodedSignature
+    {
+    public:
+        EncodedSignature() : bytes{}, length(0) {}
+        explicit EncodedSignature(std::span<const uint8_t> encoded) : EncodedSignature()
+        {
+            if (encoded.size() > bytes.size())
+                throw std::runtime_error("Invalid DER buffer");
+            std::copy(encoded.begin(), encoded.end(), bytes.begin());
+            length = encoded.size();
+        }
+
+        size_t size() const { return length; }
+        const uint8_t* data() const { return bytes.data(); }
+        const uint8_t* begin() const { return bytes.data(); }
+        const uint8_t* end() const { return bytes.data() + length; }
+        uint8_t operator [](size_t index) const { return bytes[index]; }
+
+        operator std::span<const uint8_t>() const { return { bytes.data(), length }; }
+
+        friend std::ostream& operator <<(std::ostream& os, const EncodedSignature& signature)
+        {
+            for (auto x : signature)
+                os << std::hex << std::setw(2) << std::setfill('0') << +x;
+            return os;
+        }
+
+    private:
+        template <size_t B> friend EncodedSignature<B> EncodeSignature(const Signature<B>& rs);
+
+        std::array<uint8_t, MaxEncodedByteCount<Bits>> bytes;
+        size_t length;
+    };
+
+    // Bytes needed to encode x as a minimal signed INTEGER: one more than the value needs if its top bit is set
+    template <size_t Bits>
+    unsigned int GetIntegerContentByteCount(const UIntW<Bits>& x)
+    {
+        return static_cast<unsigned int>(x.ActualBitCount() >> 3) + 1;
+    }
 
     template <size_t Bits>
     unsigned int GetEncodedByteCount(const Signature<Bits>& rs)
     {
-        const auto& r = rs.first;
-        const auto& s = rs.second;
-        const auto bytesPerScalar = Bits << 3;
-        const auto bytesToEncodeR = (r.ActualBitCount() >> 3) + 1;
-        const auto bytesToEncodeS = (s.ActualBitCount() >> 3) + 1;
-        const auto totalEncodingBytes = bytesToEncodeR + bytesToEncodeS + 6;
-        return static_cast<unsigned int>(totalEncodingBytes);
+        return GetIntegerContentByteCount(rs.first) + GetIntegerContentByteCount(rs.second) + 6;
     }
 
     template <size_t Bits>
     std::span<uint8_t> EncodeInteger(const UIntW<Bits>& x, std::span<uint8_t> buffer)
     {
-        uint8_t bytesToEncode = static_cast<uint8_t>(x.ActualBitCount() >> 3) + 1; // Minimal length encoding as signed integer
-        const uint8_t totalEncodingBytes = bytesToEncode + 2;
+        const unsigned int bytesToEncode = GetIntegerContentByteCount(x); // Minimal length encoding as signed integer
+        const unsigned int totalEncodingBytes = bytesToEncode + 2;
         if (totalEncodingBytes > buffer.size())
             throw std::runtime_error("Insufficient buffer size");
 
-        auto pb = buffer.begin();
-        *pb++ = 0x02; // Type INTEGER
-        *pb++ = bytesToEncode; // Length (Short form)
-        if (x.GetBit(Bits - 1)) // Need this byte because we are supposed to write out a signed integer
-        {
-            *pb++ = 0x00;
-            --bytesToEncode;
-        }
-        for (auto i = 0; i < bytesToEncode; ++i) // Contents
-            *pb++ = x.GetByte(bytesToEncode - 1 - i); // High bytes first for big-endian
-        return { pb, buffer.end() };
+        buffer[0] = 0x02; // Type INTEGER
+        buffer[1] = static_cast<uint8_t>(bytesToEncode); // Length (Short form)
+        x.ToBigEndianBytes(&buffer[2], bytesToEncode); // Contents, including a leading zero byte if the top bit is set
+        return buffer.subspan(totalEncodingBytes);
     }
 
     template <size_t Bits>
@@ -62,57 +100,64 @@ namespace DER
         // So bytesToEncodeR + bytesToEncodeS <= 123. So max(bytesToEncodeR) <= 61. So Bits < 495.
         static_assert(Bits < 495); // Otherwise this function needs re-writing without short-form length-encoding
 
-        const uint8_t totalEncodingBytes = GetEncodedByteCount(rs);
+        const unsigned int totalEncodingBytes = GetEncodedByteCount(rs);
         if (totalEncodingBytes > buffer.size())
             throw std::runtime_error("Insufficient buffer size");
 
-        auto pb = buffer.begin();
-        *pb++ = 0x30;   // SEQUENCE of elements
-        *pb++ = totalEncodingBytes - 2; // Length of sequence (Short form)
-        
-        buffer = EncodeInteger(rs.first, { pb, buffer.end() });
-        buffer = EncodeInteger(rs.second, buffer);
+        buffer[0] = 0x30; // SEQUENCE of elements
+        buffer[1] = static_cast<uint8_t>(totalEncodingBytes - 2); // Length of sequence (Short form)
+        EncodeInteger(rs.second, EncodeInteger(rs.first, buffer.subspan(2)));
         return totalEncodingBytes;
     }
 
     template <size_t Bits>
-    ByteStream EncodeSignature(const Signature<Bits>& rs)
+    EncodedSignature<Bits> EncodeSignature(const Signature<Bits>& rs)
     {
-        ByteStream vec(GetEncodedByteCount(rs));
-        EncodeSignature(rs, vec);
-        return vec;
+        EncodedSignature<Bits> encoded;
+        encoded.length = EncodeSignature(rs, encoded.bytes);
+        return encoded;
     }
 
+    // Strict decoding in a single pass, as in BIP 66 (for a signature without the trailing hash type byte):
+    // the sequence length must match the buffer exactly, and each integer must be non-empty, positive,
+    // minimally encoded and lie entirely within the buffer. Returns false if the encoding is invalid.
     template <size_t Bits>
-    Signature<Bits> DecodeSignature(std::span<const uint8_t> buffer)
+    bool TryDecodeSignature(std::span<const uint8_t> buffer, Signature<Bits>& rs)
     {
-        auto validate = [](bool ok)
+        if (buffer.size() < 8 || buffer.size() > MaxEncodedByteCount<Bits> || buffer[0] != 0x30 || buffer[1] != buffer.size() - 2)
+            return false;
+
+        auto decodeInteger = [&](size_t offset, UIntW<Bits>& x)
         {
-            if (!ok)
-                throw std::runtime_error("Invalid DER buffer");
+            if (offset + 2 > buffer.size() || buffer[offset] != 0x02)
+                return size_t(0);
+            const size_t length = buffer[offset + 1];
+            const size_t begin = offset + 2;
+            if (length == 0 || begin + length > buffer.size())
+                return size_t(0);
+            if ((buffer[begin] & 0x80) != 0) // Negative
+                return size_t(0);
+            if (length > 1 && buffer[begin] == 0 && (buffer[begin + 1] & 0x80) == 0) // Unnecessary leading zero
+                return size_t(0);
+
+            // Drop the sign byte, after which the value must fit in Bits
+            const size_t skip = buffer[begin] == 0 && length > 1 ? 1 : 0;
+            if (length - skip > Bits / 8)
+                return size_t(0);
+            x = UIntW<Bits>::FromBigEndianBytes(&buffer[begin + skip], length - skip);
+            return begin + length;
         };
-        Signature<Bits> rs = { {}, {} };
-
-        validate(buffer.size() >= 6);
-        auto pb = buffer.begin();
-        validate(*pb++ == 0x30);
-        uint8_t totalEncodingBytes = *pb++ + 2;
-        validate(totalEncodingBytes <= buffer.size());
-
-        validate(*pb++ == 0x02);
-        uint8_t bytesToEncodeR = *pb++;
-        validate(bytesToEncodeR << 3 <= Bits + 8);
-        for (auto i = 0; i < bytesToEncodeR; ++i, pb++)
-            if (*pb != 0) // Avoid writing the extra byte needed purely for the signed format
-                rs.first.SetByte(bytesToEncodeR - 1 - i, *pb);
-
-        validate(*pb++ == 0x02);
-        uint8_t bytesToEncodeS = *pb++;
-        validate(bytesToEncodeS << 3 <= Bits + 8);
-        for (auto i = 0; i < bytesToEncodeS; ++i, pb++)
-            if (*pb != 0) // Avoid writing the extra byte needed purely for the signed format
-                rs.second.SetByte(bytesToEncodeS - 1 - i, *pb);
 
+        const size_t next = decodeInteger(2, rs.first);
+        return next != 0 && decodeInteger(next, rs.second) == buffer.size();
+    }
+
+    template <size_t Bits>
+    Signature<Bits> DecodeSignature(std::span<const uint8_t> buffer)
+    {
+        Signature<Bits> rs;
+        if (!TryDecodeSignature(buffer, rs))
+            throw std::runtime_error("Invalid DER buffer");
         return rs;
     }
-}
\ No newline at end of file
+}
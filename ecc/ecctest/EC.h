@@ -1,17 +1,24 @@
 #pragma once
 
 #include "Fp.h"
+#include "PointTable.h"
 
 #include <random>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
 
+// Field is the type of the point coordinates: Fp<Bits, p> by default, or any type with the same operators
+// that can be constructed from a Wide and gives its reduced value through Value(), e.g. secp256k1::FieldElement<1>.
 template <size_t Bits, UIntW<Bits> p, UIntW<Bits> a, UIntW<Bits> b,
-          UIntW<Bits> Gx, UIntW<Bits> Gy, UIntW<Bits> n>
+          UIntW<Bits> Gx, UIntW<Bits> Gy, UIntW<Bits> n, typename Field = Fp<Bits, p>>
 class EllipticCurve
 {
 public:
-    using Mod_p = Fp<Bits, p>;
+    using Mod_p = Field;
     using Mod_n = Fp<Bits, n>;
-    using Wide = Mod_p::Type;
+    using Wide = UIntW<Bits>;
     using Signature = std::pair<Wide, Wide>;
 
     static_assert(p > n);
@@ -21,13 +28,12 @@ public:
     {
     public:
         constexpr Point() {}
-        constexpr Point(const Point& rhs) : x(rhs.x), y(rhs.y) {}
-        constexpr Point(Point&& rhs) : x(std::move(rhs.x)), y(std::move(rhs.y)) {}
+        constexpr Point(const Point&) = default;
         constexpr Point(const Mod_p& x, const Mod_p& y) : x(x), y(y) {}
 
         constexpr bool IsInfinity() const
         {
-            return x == 0 && y == 0;
+            return x.IsZero() && y.IsZero();
         }
 
         friend Point operator -(const Point& lhs)
@@ -42,9 +48,9 @@ public:
                 return { lhs.x + rhs.x, lhs.y + rhs.y };
             else if (lhs.x != rhs.x)
             {
-                const Fp lambda = (rhs.y - lhs.y) / (rhs.x - lhs.x);
-                const Fp x3 = lambda.Squared() - lhs.x - rhs.x;
-                const Fp y3 = lambda * (lhs.x - x3) - lhs.y;
+                const Mod_p lambda = (rhs.y - lhs.y) / (rhs.x - lhs.x);
+                const Mod_p x3 = lambda.Squared() - lhs.x - rhs.x;
+                const Mod_p y3 = lambda * (lhs.x - x3) - lhs.y;
                 return { x3, y3 };
             }
             else if (lhs.y == -rhs.y)
@@ -52,47 +58,26 @@ public:
             else
             {
                 // Add a (non-infinity) point to itself 
-                const Fp lambda = (3 * lhs.x.Squared() + a) / (lhs.y + lhs.y);
-                const Fp x3 = lambda.Squared() - (lhs.x + lhs.x);
-                const Fp y3 = lambda * (lhs.x - x3) - lhs.y;
+                const Mod_p x2 = lhs.x.Squared();
+                const Mod_p lambda = (x2 + x2 + x2 + Mod_p(a)) / (lhs.y + lhs.y);
+                const Mod_p x3 = lambda.Squared() - (lhs.x + lhs.x);
+                const Mod_p y3 = lambda * (lhs.x - x3) - lhs.y;
                 return { x3, y3 };
             }
         }
 
-        Point& operator =(const Point& rhs)
-        {
-            x = rhs.x;
-            y = rhs.y;
-            return *this;
-        }
-
-        Point& operator =(Point&& rhs)
-        {
-            x = std::move(rhs.x);
-            y = std::move(rhs.y);
-            return *this;
-        }
+        constexpr Point& operator =(const Point&) = default;
 
         Point& operator +=(const Point& rhs)
         {
             return *this = *this + rhs;
         }
 
-        // Scalar multiplication
+        // Scalar multiplication, by 4-bit windows in Jacobian coordinates (see MultiplyJacobian below)
         template <size_t Bits>
         friend Point operator *(const UIntW<Bits>& scalar, const Point& pt)
         {
-            // Scalar multiplication of elliptic curve points can be computed efficiently using the 
-            // addition rule together with the double-and-add algorithm
-            Point sum;
-            Point power = pt;
-            for (size_t bitIndex = 0; bitIndex < scalar.BitCount; ++bitIndex)
-            {
-                if (scalar.GetBit(bitIndex))
-                    sum += power;
-                power += power;
-            }
-            return sum;
+            return MultiplyJacobian(scalar, pt).ToAffine();
         }
 
         template <size_t xBits, UIntW<xBits> px>
@@ -101,20 +86,20 @@ public:
             return scalar.x * pt;
         }
 
-        std::array<uint8_t, sizeof(Mod_p) + 1> Compressed() const
+        std::array<uint8_t, Bits / 8 + 1> Compressed() const
         {
-            std::array<uint8_t, sizeof(Mod_p) + 1> rv;
-            rv[0] = (y.x & 1) ? 0x03 : 0x02;
-            std::copy(x.x.beginBigEndianBytes(), x.x.endBigEndianBytes(), rv.begin() + 1);
+            std::array<uint8_t, Bits / 8 + 1> rv;
+            rv[0] = y.Value().IsOdd() ? 0x03 : 0x02;
+            x.Value().ToBigEndianBytes(&rv[1], Bits / 8);
             return rv;
         }
 
-        std::array<uint8_t, 2 * sizeof(Mod_p) + 1> Uncompressed() const
+        std::array<uint8_t, 2 * (Bits / 8) + 1> Uncompressed() const
         {
-            std::array<uint8_t, 2 * sizeof(Mod_p) + 1> rv;
+            std::array<uint8_t, 2 * (Bits / 8) + 1> rv;
             rv[0] = 0x04;
-            std::copy(x.x.beginBigEndianBytes(), x.x.endBigEndianBytes(), rv.begin() + 1);
-            std::copy(y.x.beginBigEndianBytes(), y.x.endBigEndianBytes(), rv.begin() + 1 + sizeof(Mod_p));
+            x.Value().ToBigEndianBytes(&rv[1], Bits / 8);
+            y.Value().ToBigEndianBytes(&rv[1 + Bits / 8], Bits / 8);
             return rv;
         }
 
@@ -129,8 +114,206 @@ public:
         Mod_p x, y;
     };
 
+    // A point in Jacobian coordinates, representing (X / Z^2, Y / Z^3), with Z = 0 at infinity.
+    // Adding an affine point or doubling needs no inversion, so sums are accumulated in this form
+    // and made affine once at the end, or many at a time with one shared inversion (see ToAffine below).
+    class JacobianPoint
+    {
+    public:
+        JacobianPoint() {}
+        JacobianPoint(const Point& point) : X(point.x), Y(point.y), Z(point.IsInfinity() ? 0u : 1u) {}
+
+        bool IsInfinity() const
+        {
+            return Z.IsZero();
+        }
+
+        JacobianPoint Doubled() const
+        {
+            if (IsInfinity() || Y.IsZero())
+                return {};
+            const Mod_p XX = X.Squared(), YY = Y.Squared(), YYYY = YY.Squared();
+            const Mod_p XYY = X * YY;
+            const Mod_p S = XYY + XYY + XYY + XYY; // 4 X Y^2
+            Mod_p M = XX + XX + XX; // 3 X^2 + a Z^4
+            if constexpr (!a.IsZero())
+                M = M + Mod_p(a) * Z.Squared().Squared();
+            const Mod_p YYYY2 = YYYY + YYYY, YYYY4 = YYYY2 + YYYY2;
+            const Mod_p YZ = Y * Z;
+
+            JacobianPoint rv;
+            rv.X = M.Squared() - (S + S);
+            rv.Y = M * (S - rv.X) - (YYYY4 + YYYY4);
+            rv.Z = YZ + YZ;
+            return rv;
+        }
+
+        // Add an affine point
+        friend JacobianPoint operator +(const JacobianPoint& lhs, const Point& rhs)
+        {
+            if (rhs.IsInfinity())
+                return lhs;
+            if (lhs.IsInfinity())
+                return rhs;
+
+            // Bring rhs to the same Z: U2 = x2 Z1^2, S2 = y2 Z1^3
+            const Mod_p ZZ = lhs.Z.Squared();
+            const Mod_p U2 = rhs.x * ZZ;
+            const Mod_p S2 = rhs.y * (ZZ * lhs.Z);
+            const Mod_p H = U2 - lhs.X;
+            const Mod_p R = S2 - lhs.Y;
+            if (H.IsZero())
+                return R.IsZero() ? JacobianPoint(rhs).Doubled() : JacobianPoint();
+
+            const Mod_p HH = H.Squared();
+            const Mod_p HHH = H * HH;
+            const Mod_p V = lhs.X * HH;
+
+            JacobianPoint rv;
+            rv.X = R.Squared() - HHH - (V + V);
+            rv.Y = R * (V - rv.X) - lhs.Y * HHH;
+            rv.Z = lhs.Z * H;
+            return rv;
+        }
+
+        JacobianPoint& operator +=(const Point& rhs)
+        {
+            return *this = *this + rhs;
+        }
+
+        Point ToAffine() const
+        {
+            if (IsInfinity())
+                return {};
+            const Mod_p zInverse = Z.Inverse();
+            const Mod_p zInverse2 = zInverse.Squared();
+            return { X * zInverse2, Y * (zInverse2 * zInverse) };
+        }
+
+        Mod_p X, Y, Z;
+    };
+
+    // Plain data throughout, so arrays of these can be copied with memcpy and loops over them vectorized
+    static_assert(std::is_trivially_copyable_v<Wide> && std::is_standard_layout_v<Wide>);
+    static_assert(std::is_trivially_copyable_v<Mod_p> && std::is_standard_layout_v<Mod_p>);
+    static_assert(std::is_trivially_copyable_v<Point> && std::is_standard_layout_v<Point>);
+
+    // Make many points affine with a single field inversion between them (see InvertBatch)
+    inline static void ToAffine(std::span<const JacobianPoint> points, std::span<Point> affine)
+    {
+        if (affine.size() != points.size())
+            throw std::invalid_argument("Output span must match the number of points");
+
+        std::vector<Mod_p> zInverses;
+        zInverses.reserve(points.size());
+        for (const JacobianPoint& point : points)
+            if (!point.IsInfinity())
+                zInverses.push_back(point.Z);
+        InvertBatch<Mod_p>(zInverses);
+
+        for (size_t i = 0, j = 0; i < points.size(); ++i)
+        {
+            if (points[i].IsInfinity())
+            {
+                affine[i] = {};
+                continue;
+            }
+            const Mod_p zInverse2 = zInverses[j].Squared();
+            affine[i] = { points[i].X * zInverse2, points[i].Y * (zInverse2 * zInverses[j]) };
+            ++j;
+        }
+    }
+
+    // The multiples j P for j = 1..15 of a point P, for multiplying by it a 4-bit window at a time
+    static constexpr size_t WindowBits = 4;
+    using WindowTable = std::array<Point, (size_t(1) << WindowBits) - 1>;
+
+    // Build the window tables of many points, with one inversion between them all
+    inline static void BuildWindowTables(std::span<const Point> points, std::span<WindowTable> tables)
+    {
+        constexpr size_t DigitCount = std::tuple_size_v<WindowTable>;
+        if (tables.size() != points.size())
+            throw std::invalid_argument("Output span must match the number of points");
+
+        std::vector<JacobianPoint> multiples(points.size() * DigitCount);
+        for (size_t i = 0; i < points.size(); ++i)
+        {
+            JacobianPoint* row = &multiples[i * DigitCount];
+            row[0] = points[i];
+            row[1] = row[0].Doubled();
+            for (size_t j = 2; j < DigitCount; ++j)
+                row[j] = row[j - 1] + points[i];
+        }
+        std::vector<Point> affine(multiples.size());
+        ToAffine(multiples, affine);
+        for (size_t i = 0; i < points.size(); ++i)
+            std::copy(affine.begin() + i * DigitCount, affine.begin() + (i + 1) * DigitCount, tables[i].begin());
+    }
+
+    // scalar P from the window table of P: four doublings and at most one addition for every 4 bits of the scalar,
+    // where double-and-add in affine coordinates would need an inversion for every bit
+    template <size_t ScalarBits>
+    inline static JacobianPoint MultiplyJacobian(const UIntW<ScalarBits>& scalar, const WindowTable& table)
+    {
+        return MultiplyMulti(std::span(&scalar, 1), std::span(&table, 1));
+    }
+
+    template <size_t ScalarBits>
+    inline static JacobianPoint MultiplyJacobian(const UIntW<ScalarBits>& scalar, const Point& point)
+    {
+        WindowTable table;
+        BuildWindowTables(std::span(&point, 1), std::span(&table, 1));
+        return MultiplyJacobian(scalar, table);
+    }
+
+    // The sum of scalars[i] P_i, given the window table of each P_i, with the windows interleaved (Straus's method):
+    // all the products share one run of doublings, so each term adds only its additions, and short scalars add fewer
+    template <size_t ScalarBits>
+    inline static JacobianPoint MultiplyMulti(std::span<const UIntW<ScalarBits>> scalars, std::span<const WindowTable> tables)
+    {
+        constexpr size_t BitsPerWord = sizeof(typename UIntW<ScalarBits>::Base) * 8;
+        static_assert(BitsPerWord % WindowBits == 0);
+        if (tables.size() != scalars.size())
+            throw std::invalid_argument("Expected one window table per scalar");
+
+        size_t bitCount = 0;
+        for (const auto& scalar : scalars)
+            bitCount = std::max(bitCount, scalar.ActualBitCount());
+        JacobianPoint sum;
+        for (size_t bit = (bitCount + WindowBits - 1) / WindowBits * WindowBits; bit > 0; )
+        {
+            bit -= WindowBits;
+            for (size_t i = 0; i < WindowBits; ++i)
+                sum = sum.Doubled();
+            for (size_t i = 0; i < scalars.size(); ++i)
+            {
+                const size_t digit = (scalars[i].m_a[bit / BitsPerWord] >> (bit % BitsPerWord)) & tables[i].size();
+                if (digit != 0)
+                    sum += tables[i][digit - 1];
+            }
+        }
+        return sum;
+    }
+
     static constexpr Point G = { Gx, Gy };
 
+    // Precomputed multiples of a point, for repeated multiplication by it (see PointTable.h)
+    using Table = PointTable<EllipticCurve>;
+
+    // The table for G, built on first use
+    inline static const Table& GeneratorTable()
+    {
+        static const Table table(G);
+        return table;
+    }
+
+    // u1 G + u2 Q, sharing one accumulator: u2 Q by windows, then u1 G from the generator table, which needs no doublings,
+    // and a single inversion at the end
+    inline static Point MultiplyJoint(const Wide& u1, const Wide& u2, const Point& Q)
+    {
+        return GeneratorTable().MultiplyJacobian(u1, MultiplyJacobian(u2, Q)).ToAffine();
+    }
+
     template <typename Rnd>
     inline static Wide GenerateRandomPrivateKey(Rnd& rnd)
     {
@@ -139,8 +322,11 @@ public:
         do
         {
             typename Wide::Array arr;
-            for (size_t i = 0; i < arr.size(); ++i)
-                arr[i] = uniform(rnd);
+            if constexpr (requires { rnd.Fill(std::as_writable_bytes(std::span(arr))); })
+                rnd.Fill(std::as_writable_bytes(std::span(arr))); // Whole scalar in one call, e.g. Random::SecureGenerator
+            else
+                for (size_t i = 0; i < arr.size(); ++i)
+                    arr[i] = uniform(rnd);
             d = arr;
         } while (d == 0 || d >= n);
         return d;
@@ -151,12 +337,29 @@ public:
         if (point.IsInfinity())
             return true;
         const auto lhs = point.y.Squared();
-        const auto rhs = (point.x.Squared() + a) * point.x + b;
+        const auto rhs = (point.x.Squared() + Mod_p(a)) * point.x + Mod_p(b);
         return lhs == rhs;
     }
 
     static_assert(IsOnCurve(G));
 
+    // The point with the given x and parity of y, as in a compressed public key. Returns false if x is not in the field,
+    // or not the x of a point on the curve.
+    inline static bool TryDecompress(const Wide& x, bool isOddY, Point& point)
+    {
+        if (x >= p)
+            return false;
+        const Mod_p xp = x;
+        const Mod_p ySquared = (xp.Squared() + Mod_p(a)) * xp + Mod_p(b);
+        Mod_p y;
+        if (!ySquared.TrySquareRoot(y))
+            return false;
+        if (y.Value().IsOdd() != isOddY)
+            y = -y;
+        point = { xp, y };
+        return true;
+    }
+
     inline static bool IsValidPrivateKey(const Wide& privateKey)
     {
         return privateKey > Wide(0) && privateKey < n;
@@ -166,7 +369,7 @@ public:
     {
         if (publicKey.IsInfinity())
             return false;
-        if (publicKey.x.x >= p || publicKey.y.x >= p)
+        if (publicKey.x.Value() >= p || publicKey.y.Value() >= p)
             return false;
         if (!IsOnCurve(publicKey))
             return false;
@@ -180,24 +383,74 @@ public:
         if (!IsValidPrivateKey(privateKey))
             throw std::invalid_argument("Invalid private key");
 
-        return privateKey * G;
+        return GeneratorTable().Multiply(privateKey);
     }
 
+    // rnd is a random generator for the nonces, or a nonce policy such as RFC6979::Nonces for deterministic signatures
     template <typename Rnd, typename HashFunc>
     inline static Signature SignMessage(const Wide& privateKey, const char* byteStream, size_t sizeInBytes, Rnd& rnd, HashFunc& hashFunc)
     {
-        while (true)
+        return Sign(privateKey, HashToInt(hashFunc(byteStream, byteStream + sizeInBytes)), rnd);
+    }
+
+    // Sign a message digest that has already been computed, e.g. a 32-byte sighash, taken as a big-endian integer
+    template <typename Rnd>
+    inline static Signature SignDigest(const Wide& privateKey, std::span<const uint8_t, Bits / 8> digest, Rnd& rnd)
+    {
+        return Sign(privateKey, HashToInt(digest), rnd);
+    }
+
+    // As SignDigest, also giving the recovery id for RecoverPublicKey. Bit 0 is the parity of the y of the nonce point R,
+    // and bit 1 is set if R.x was reduced modulo n to give r, which happens with probability about 2^-127.
+    template <typename Rnd>
+    inline static Signature SignDigestRecoverable(const Wide& privateKey, std::span<const uint8_t, Bits / 8> digest, Rnd& rnd, int& recoveryId)
+    {
+        return Sign(privateKey, HashToInt(digest), rnd, &recoveryId);
+    }
+
+    // Sign many hashes (as returned by a hashFunc of SignMessage), with either one private key for all or one for each.
+    // The nonce points come from the generator table in Jacobian form and are made affine together,
+    // and all the nonces are inverted together, so no signature needs an inversion of its own.
+    template <size_t Size, typename Rnd>
+    inline static void SignBatch(std::span<const Wide> privateKeys, std::span<const std::array<typename Wide::Base, Size>> hashes, Rnd& rnd, std::span<Signature> signatures)
+    {
+        const size_t count = hashes.size();
+        if (privateKeys.size() != 1 && privateKeys.size() != count)
+            throw std::invalid_argument("Expected one private key, or one per hash");
+        if (signatures.size() != count)
+            throw std::invalid_argument("Output span must match the number of hashes");
+        for (const Wide& privateKey : privateKeys)
+            if (!IsValidPrivateKey(privateKey))
+                throw std::invalid_argument("Invalid private key");
+
+        std::vector<Mod_n> e(count), k(count), kInverse(count);
+        std::vector<decltype(NonceCandidates(privateKeys[0], e[0], rnd))> candidates;
+        candidates.reserve(count);
+        std::vector<JacobianPoint> jacobian(count);
+        std::vector<Point> R(count);
+        for (size_t i = 0; i < count; ++i)
         {
-            const Mod_n k = GenerateRandomPrivateKey(rnd);
-            const Point R = k * G;
-            const Mod_n r = R.x;
-            if (r == 0)
-                continue;
-            const auto H = hashFunc(byteStream, byteStream + sizeInBytes);
-            const Mod_n e = HashToInt(H), d_U = privateKey;
-            const Mod_n s = (e + r * d_U) / k;
-            if (s != 0)
-                return { r.x, s.x };
+            e[i] = HashToInt(hashes[i]);
+            candidates.push_back(NonceCandidates(privateKeys[privateKeys.size() == 1 ? 0 : i], e[i], rnd));
+            k[i] = NextNonce(candidates[i]);
+            jacobian[i] = GeneratorTable().MultiplyJacobian(k[i].x);
+        }
+        ToAffine(jacobian, R);
+        std::copy(k.begin(), k.end(), kInverse.begin());
+        InvertBatch<Mod_n>(kInverse);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            const Mod_n d_U = privateKeys[privateKeys.size() == 1 ? 0 : i];
+            Mod_n r = R[i].x.Value();
+            Mod_n s = (e[i] + r * d_U) * kInverse[i];
+            while (r == 0 || s == 0) // Vanishingly rare: try again with the next nonce, on its own
+            {
+                const Mod_n k1 = NextNonce(candidates[i]);
+                r = GeneratorTable().Multiply(k1.x).x.Value();
+                s = (e[i] + r * d_U) / k1;
+            }
+            signatures[i] = { r.x, s.x };
         }
     }
 
@@ -206,27 +459,198 @@ public:
     {
         if (!IsPublicKeyValid(publicKey))
             throw std::invalid_argument("Invalid public key");
+        return Verify(signature, HashToInt(hashFunc(byteStream, byteStream + sizeInBytes)), [&](const Mod_n& u2) { return MultiplyJacobian(u2.x, publicKey); });
+    }
+
+    // Verify against a message digest that has already been computed, as for SignDigest
+    inline static bool VerifyDigest(const Point& publicKey, const Signature& signature, std::span<const uint8_t, Bits / 8> digest)
+    {
+        if (!IsPublicKeyValid(publicKey))
+            throw std::invalid_argument("Invalid public key");
+        return Verify(signature, HashToInt(digest), [&](const Mod_n& u2) { return MultiplyJacobian(u2.x, publicKey); });
+    }
+
+    // As VerifySignature, for a public key already checked with IsPublicKeyValid, e.g. by an earlier stage of a pipeline
+    template <typename HashFunc>
+    inline static bool VerifySignatureForValidKey(const Point& publicKey, const Signature& signature, const char* byteStream, size_t sizeInBytes, HashFunc& hashFunc)
+    {
+        return Verify(signature, HashToInt(hashFunc(byteStream, byteStream + sizeInBytes)), [&](const Mod_n& u2) { return MultiplyJacobian(u2.x, publicKey); });
+    }
+
+    // Verify with the precomputed table of a public key, e.g. from a PointTableCache, which has validated the key already
+    template <typename HashFunc>
+    inline static bool VerifySignature(const Table& publicKeyTable, const Signature& signature, const char* byteStream, size_t sizeInBytes, HashFunc& hashFunc)
+    {
+        return Verify(signature, HashToInt(hashFunc(byteStream, byteStream + sizeInBytes)), [&](const Mod_n& u2) { return publicKeyTable.MultiplyJacobian(u2.x); });
+    }
+
+    // Verify a signature in compact form: r then s, each as Bits / 8 big-endian bytes, e.g. a record in a flat array
+    template <typename HashFunc>
+    inline static bool VerifySignature(const Point& publicKey, std::span<const uint8_t, 2 * (Bits / 8)> compactSignature, const char* byteStream, size_t sizeInBytes, HashFunc& hashFunc)
+    {
+        const Signature signature = { Wide::FromBigEndianBytes(compactSignature.data(), Bits / 8), Wide::FromBigEndianBytes(compactSignature.data() + Bits / 8, Bits / 8) };
+        return VerifySignature(publicKey, signature, byteStream, sizeInBytes, hashFunc);
+    }
+
+    // The public key that made signature (r, s) of digest, given its recovery id: Q = r^-1 (s R - e G), where the nonce point R
+    // is decompressed from r with one square root, and the two products come from one joint multiplication.
+    // Returns false if there is no such key, e.g. if r is not the x of a point on the curve.
+    inline static bool TryRecoverPublicKey(std::span<const uint8_t, Bits / 8> digest, const Wide& r, const Wide& s, int recoveryId, Point& publicKey)
+    {
+        Point R;
+        if (!TryRecoverNoncePoint(r, s, recoveryId, R))
+            return false;
+        const Mod_n rInverse = Mod_n(r).Inverse();
+        const Mod_n e = HashToInt(digest);
+        publicKey = MultiplyJoint((-(e * rInverse)).x, (Mod_n(s) * rInverse).x, R);
+        return !publicKey.IsInfinity();
+    }
+
+    // As TryRecoverPublicKey, throwing std::invalid_argument if there is no such key
+    inline static Point RecoverPublicKey(std::span<const uint8_t, Bits / 8> digest, const Wide& r, const Wide& s, int recoveryId)
+    {
+        Point publicKey;
+        if (!TryRecoverPublicKey(digest, r, s, recoveryId, publicKey))
+            throw std::invalid_argument("No public key can be recovered from the signature");
+        return publicKey;
+    }
+
+    // Recover many public keys (from hashes as returned by a hashFunc of SignMessage). The inversions of all the r are shared,
+    // the window tables of all the nonce points are built together, and the results are made affine together,
+    // so there are three inversions in all. publicKeys[i] is the point at infinity where recovery fails.
+    template <size_t Size>
+    inline static void RecoverPublicKeys(std::span<const std::array<typename Wide::Base, Size>> hashes, std::span<const Signature> signatures, std::span<const int> recoveryIds, std::span<Point> publicKeys)
+    {
+        const size_t count = hashes.size();
+        if (signatures.size() != count || recoveryIds.size() != count)
+            throw std::invalid_argument("Expected one signature and recovery id per hash");
+        if (publicKeys.size() != count)
+            throw std::invalid_argument("Output span must match the number of hashes");
+
+        std::vector<size_t> indices; // Of the signatures with a nonce point
+        std::vector<Point> R;
+        std::vector<Mod_n> rInverse;
+        for (size_t i = 0; i < count; ++i)
+        {
+            publicKeys[i] = {};
+            Point point;
+            if (!TryRecoverNoncePoint(signatures[i].first, signatures[i].second, recoveryIds[i], point))
+                continue;
+            indices.push_back(i);
+            R.push_back(point);
+            rInverse.push_back(signatures[i].first);
+        }
+        InvertBatch<Mod_n>(rInverse);
+        std::vector<WindowTable> tables(R.size());
+        BuildWindowTables(R, tables);
+
+        std::vector<JacobianPoint> sums(R.size());
+        for (size_t k = 0; k < R.size(); ++k)
+        {
+            const size_t i = indices[k];
+            const Mod_n e = HashToInt(hashes[i]);
+            const Mod_n u1 = -(e * rInverse[k]), u2 = Mod_n(signatures[i].second) * rInverse[k];
+            sums[k] = GeneratorTable().MultiplyJacobian(u1.x, MultiplyJacobian(u2.x, tables[k]));
+        }
+        std::vector<Point> affine(R.size());
+        ToAffine(sums, affine);
+        for (size_t k = 0; k < R.size(); ++k)
+            publicKeys[indices[k]] = affine[k];
+    }
+
+private:
+    // The nonce candidates for signing the hash e: from a nonce policy such as RFC6979::Nonces, or random draws from rnd
+    template <typename Rnd>
+    inline static auto NonceCandidates(const Wide& privateKey, const Mod_n& e, Rnd& rnd)
+    {
+        if constexpr (requires { rnd.Start(privateKey, e.x); })
+            return rnd.Start(privateKey, e.x);
+        else
+            return [&rnd]() { return GenerateRandomPrivateKey(rnd); };
+    }
+
+    // The next candidate in [1, n)
+    template <typename Candidates>
+    inline static Mod_n NextNonce(Candidates& candidates)
+    {
+        while (true)
+        {
+            const Wide k = candidates();
+            if (IsValidPrivateKey(k))
+                return k;
+        }
+    }
+
+    // Sign the hash e. Only the nonce changes if a retry is needed, so the message is never hashed again.
+    template <typename Rnd>
+    inline static Signature Sign(const Wide& privateKey, const Mod_n& e, Rnd& rnd, int* recoveryId = nullptr)
+    {
+        const Mod_n d_U = privateKey;
+        auto candidates = NonceCandidates(privateKey, e, rnd);
+        while (true)
+        {
+            const Mod_n k = NextNonce(candidates);
+            const Point R = GeneratorTable().Multiply(k.x);
+            const Mod_n r = R.x.Value();
+            if (r == 0)
+                continue;
+            const Mod_n s = (e + r * d_U) / k;
+            if (s == 0)
+                continue;
+            if (recoveryId)
+                *recoveryId = (R.y.Value().IsOdd() ? 1 : 0) | (R.x.Value() >= n ? 2 : 0);
+            return { r.x, s.x };
+        }
+    }
+
+    // The nonce point R of a signature, from r and the recovery id, after checking both are in range
+    inline static bool TryRecoverNoncePoint(const Wide& r, const Wide& s, int recoveryId, Point& R)
+    {
+        if (r == 0 || r >= n || s == 0 || s >= n || recoveryId < 0 || recoveryId > 3)
+            return false;
+        Wide x = r;
+        if (recoveryId & 2)
+        {
+            constexpr Wide xLimit = p - n; // R.x = r + n must still be a field element
+            if (r >= xLimit)
+                return false;
+            x = r.AddTruncate(n);
+        }
+        return TryDecompress(x, recoveryId & 1, R);
+    }
+
+    // The checks and arithmetic shared by the verification overloads, given the hash e and how to compute u2 * publicKey
+    // in Jacobian form. u1 G is added to that from the generator table, so there is one inversion in all.
+    template <typename MultiplyPublicKey>
+    inline static bool Verify(const Signature& signature, const Mod_n& e, MultiplyPublicKey multiplyPublicKey)
+    {
         if (signature.first == 0 || signature.first >= n)
             return false;
         if (signature.second == 0 || signature.second >= n)
             return false;
-        const auto H = hashFunc(byteStream, byteStream + sizeInBytes);
-        const Mod_n e = HashToInt(H), r = signature.first, s = signature.second;
+        const Mod_n r = signature.first, s = signature.second;
         const auto sinv = s.Inverse();
         const auto u1 = e * sinv;
         const auto u2 = r * sinv;
-        const Point R = u1 * G + u2 * publicKey;
+        const Point R = GeneratorTable().MultiplyJacobian(u1.x, multiplyPublicKey(u2)).ToAffine();
         if (R.IsInfinity())
             return false;
-        return R.x.x == r.x;
+        return R.x.Value() == r.x;
     }
 
-private:
+    // A hash as an integer: the most significant word (or byte) comes first
     template <size_t Size> 
     inline static Wide HashToInt(const std::array<typename Wide::Base, Size>& hash)
     {
-        auto H = hash;
-        std::reverse(H.begin(), H.end()); // Reverse words to have the correct endian-ness for conversion to wide integer
-        return H;
+        static_assert(Size == Wide::ElementCount);
+        Wide x;
+        for (size_t i = 0; i < Size; ++i)
+            x.m_a[i] = hash[Size - 1 - i];
+        return x;
+    }
+
+    inline static Wide HashToInt(std::span<const uint8_t, Bits / 8> digest)
+    {
+        return Wide::FromBigEndianBytes(digest.data(), digest.size());
     }
 };
\ No newline at end of file
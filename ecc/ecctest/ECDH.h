@@ -0,0 +1,217 @@
+#pragma once
+
+/*
+* Elliptic curve Diffie-Hellman on secp256k1, e.g. for encrypted peer transport.
+*
+* The shared secret is the SHA-256 of the shared point k P in compressed form (0x02 or 0x03, then x), as libsecp256k1
+* gives it by default. The peer's key may be compressed (33 bytes) or x-only (32 bytes, taken with even y as in BIP 340).
+*
+* The private key is secret, so the multiplication is a Montgomery ladder: 256 steps of one addition and one doubling
+* whatever the bits, with the two points swapped by masks rather than branches. The points are in homogeneous projective
+* coordinates with the complete formulas of Renes, Costello and Batina (https://eprint.iacr.org/2015/1060, Algorithms 7
+* and 9, for a = 0), which have no special cases for doubling or infinity and so no branches either.
+*
+* DeriveBatch runs the ladders for many peers in lock step, sharing the bits and swaps of the one private key,
+* makes all the shared points affine with one inversion, and hashes them eight at a time in lanes (SHA256::ComputeBatch).
+*/
+
+#include "Bitcoin.h"
+
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace ECDH
+{
+    using SharedSecret = Bitcoin::LongHash;
+
+    // Throws std::invalid_argument if the private key or the peer's key is not valid
+    SharedSecret Derive(const Bitcoin::PrivateKey& privateKey, std::span<const uint8_t> peerKey);
+
+    // One private key against many peers
+    void DeriveBatch(const Bitcoin::PrivateKey& privateKey, std::span<const std::span<const uint8_t>> peerKeys, std::span<SharedSecret> secrets);
+}
+
+
+/* Implementation follows */
+
+namespace ECDH
+{
+namespace Detail
+{
+    using EC = Bitcoin::EC;
+    using Mod_p = EC::Mod_p;
+
+    // (X / Z, Y / Z), or the point at infinity (0 : 1 : 0) when Z = 0
+    struct ProjectivePoint
+    {
+        Mod_p X = 0u, Y = 1u, Z = 0u;
+    };
+
+    static_assert(secp256k1::a.IsZero() && secp256k1::b == secp256k1::Wide(7u), "The formulas below are for a = 0 and b = 7");
+
+    inline Mod_p TimesB3(const Mod_p& x)
+    {
+        static constexpr Mod_p b3 = 3 * 7u;
+        return b3 * x;
+    }
+
+    // Algorithm 7: 12 multiplications, 2 by 3b
+    inline ProjectivePoint Add(const ProjectivePoint& P, const ProjectivePoint& Q)
+    {
+        Mod_p t0 = P.X * Q.X, t1 = P.Y * Q.Y, t2 = P.Z * Q.Z;
+        Mod_p t3 = (P.X + P.Y) * (Q.X + Q.Y);
+        Mod_p t4 = t0 + t1;
+        t3 = t3 - t4;
+        t4 = (P.Y + P.Z) * (Q.Y + Q.Z);
+        ProjectivePoint R;
+        R.X = t1 + t2;
+        t4 = t4 - R.X;
+        R.X = (P.X + P.Z) * (Q.X + Q.Z);
+        R.Y = t0 + t2;
+        R.Y = R.X - R.Y;
+        R.X = t0 + t0;
+        t0 = R.X + t0;
+        t2 = TimesB3(t2);
+        R.Z = t1 + t2;
+        t1 = t1 - t2;
+        R.Y = TimesB3(R.Y);
+        R.X = t4 * R.Y;
+        t2 = t3 * t1;
+        R.X = t2 - R.X;
+        R.Y = R.Y * t0;
+        t1 = t1 * R.Z;
+        R.Y = t1 + R.Y;
+        t0 = t0 * t3;
+        R.Z = R.Z * t4;
+        R.Z = R.Z + t0;
+        return R;
+    }
+
+    // Algorithm 9: 6 multiplications and 2 squarings, 1 by 3b
+    inline ProjectivePoint Double(const ProjectivePoint& P)
+    {
+        Mod_p t0 = P.Y.Squared();
+        ProjectivePoint R;
+        R.Z = t0 + t0;
+        R.Z = R.Z + R.Z;
+        R.Z = R.Z + R.Z;
+        Mod_p t1 = P.Y * P.Z;
+        Mod_p t2 = TimesB3(P.Z.Squared());
+        R.X = t2 * R.Z;
+        R.Y = t0 + t2;
+        R.Z = t1 * R.Z;
+        t1 = t2 + t2;
+        t2 = t1 + t2;
+        t0 = t0 - t2;
+        R.Y = t0 * R.Y;
+        R.Y = R.X + R.Y;
+        t1 = P.X * P.Y;
+        R.X = t0 * t1;
+        R.X = R.X + R.X;
+        return R;
+    }
+
+    // Swap a and b if swap is 1, leave them if it is 0, with the same memory accesses either way
+    inline void ConditionalSwap(ProjectivePoint& a, ProjectivePoint& b, uint64_t swap)
+    {
+        const uint64_t mask = 0 - swap;
+        auto swapField = [mask](Mod_p& x, Mod_p& y)
+        {
+            for (size_t i = 0; i < x.n.size(); ++i)
+            {
+                const uint64_t t = (x.n[i] ^ y.n[i]) & mask;
+                x.n[i] ^= t;
+                y.n[i] ^= t;
+            }
+        };
+        swapField(a.X, b.X);
+        swapField(a.Y, b.Y);
+        swapField(a.Z, b.Z);
+    }
+
+    // k P for each point, by Montgomery ladders in lock step. Each step keeps R1 = R0 + P and, for bit b of k,
+    // sets R_(1-b) = R0 + R1 and R_b = 2 R_b. Swapping before and after turns this into always doubling R0.
+    inline void Ladder(const EC::Wide& k, std::span<const EC::Point> points, std::span<ProjectivePoint> results)
+    {
+        std::vector<ProjectivePoint> R0(points.size()), R1(points.size());
+        for (size_t i = 0; i < points.size(); ++i)
+            R1[i] = { points[i].x, points[i].y, 1u };
+
+        constexpr size_t BitsPerWord = sizeof(EC::Wide::Base) * 8;
+        uint64_t swap = 0;
+        for (size_t bit = EC::Wide::BitCount; bit-- > 0; )
+        {
+            const uint64_t b = (k.m_a[bit / BitsPerWord] >> (bit % BitsPerWord)) & 1;
+            swap ^= b;
+            for (size_t i = 0; i < points.size(); ++i)
+            {
+                ConditionalSwap(R0[i], R1[i], swap);
+                R1[i] = Add(R0[i], R1[i]);
+                R0[i] = Double(R0[i]);
+            }
+            swap = b;
+        }
+        for (size_t i = 0; i < points.size(); ++i)
+        {
+            ConditionalSwap(R0[i], R1[i], swap);
+            results[i] = R0[i];
+        }
+    }
+
+    inline EC::Point ParsePeerKey(std::span<const uint8_t> peerKey)
+    {
+        EC::Point point;
+        bool valid = false;
+        if (peerKey.size() == 33 && (peerKey[0] == 0x02 || peerKey[0] == 0x03))
+            valid = EC::TryDecompress(EC::Wide::FromBigEndianBytes(peerKey.data() + 1, 32), peerKey[0] == 0x03, point);
+        else if (peerKey.size() == 32)
+            valid = EC::TryDecompress(EC::Wide::FromBigEndianBytes(peerKey.data(), 32), false, point);
+        if (!valid)
+            throw std::invalid_argument("Invalid peer public key");
+        return point;
+    }
+}
+
+inline SharedSecret Derive(const Bitcoin::PrivateKey& privateKey, std::span<const uint8_t> peerKey)
+{
+    SharedSecret secret;
+    DeriveBatch(privateKey, std::span(&peerKey, 1), std::span(&secret, 1));
+    return secret;
+}
+
+inline void DeriveBatch(const Bitcoin::PrivateKey& privateKey, std::span<const std::span<const uint8_t>> peerKeys, std::span<SharedSecret> secrets)
+{
+    using namespace Detail;
+    if (!EC::IsValidPrivateKey(privateKey))
+        throw std::invalid_argument("Invalid private key");
+    if (secrets.size() != peerKeys.size())
+        throw std::invalid_argument("Output span must match the number of peer keys");
+
+    const size_t count = peerKeys.size();
+    std::vector<EC::Point> points(count);
+    for (size_t i = 0; i < count; ++i)
+        points[i] = ParsePeerKey(peerKeys[i]);
+
+    // The shared points are never infinity, as the peer points have the prime order n and 0 < k < n
+    std::vector<ProjectivePoint> shared(count);
+    Ladder(privateKey, points, shared);
+    std::vector<Mod_p> zInverses(count);
+    for (size_t i = 0; i < count; ++i)
+        zInverses[i] = shared[i].Z;
+    InvertBatch<Mod_p>(zInverses);
+
+    std::vector<std::array<uint8_t, 33>> compressed(count);
+    std::vector<std::span<const uint8_t>> messages(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const EC::Point point = { shared[i].X * zInverses[i], shared[i].Y * zInverses[i] };
+        compressed[i] = point.Compressed();
+        messages[i] = compressed[i];
+    }
+    std::vector<SHA256::Hash> hashes(count);
+    SHA256::ComputeBatch(messages, hashes);
+    for (size_t i = 0; i < count; ++i)
+        secrets[i] = ToBytesAsBigEndian(hashes[i]);
+}
+}
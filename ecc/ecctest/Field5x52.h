@@ -0,0 +1,411 @@
+#pragma once
+
+/*
+* The secp256k1 base field, p = 2^256 - 2^32 - 977, with lazy reduction.
+*
+* An element is five 52-bit limbs in 64-bit words: value = n[0] + n[1] 2^52 + n[2] 2^104 + n[3] 2^156 + n[4] 2^208.
+* The 12 spare bits per word let sums and negations skip reduction entirely. The magnitude M of an element bounds its limbs:
+* n[0..3] <= 2M (2^52 - 1) and n[4] <= 2M (2^48 - 1). It is a template parameter, so the bound is tracked at compile time:
+* adding magnitudes M1 and M2 gives M1 + M2, negating gives M + 1, and multiplying or squaring (inputs up to 8) gives 1.
+* Assigning to a lower magnitude reduces weakly, i.e. folds the carries back in without a full comparison with p.
+* Only comparisons and Value() reduce fully. In _DEBUG builds every result is also checked against its magnitude bound.
+*
+* FieldElement<1> can be used as the Mod_p of an EllipticCurve (see secp256k1.h).
+*/
+
+#include "Wide.h"
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+
+namespace secp256k1
+{
+    template <unsigned Magnitude>
+    class FieldElement
+    {
+    public:
+        static_assert(Magnitude >= 1 && Magnitude <= 32);
+
+        using Type = UIntW<256>;
+        using Base = Type::Base;
+        static constexpr Type Modulus = {{ 0xFFFFFC2F, 0xFFFFFFFE, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF }};
+
+        constexpr FieldElement() : n{} {}
+        constexpr FieldElement(Base x) : n{ x, 0, 0, 0, 0 } {}
+        constexpr FieldElement(const Type& x); // Any 256-bit value, reduced mod p lazily
+
+        // From any other magnitude, reducing weakly if the bound would not hold otherwise
+        template <unsigned M> constexpr FieldElement(const FieldElement<M>& rhs);
+
+        // The fully reduced value in [0, p)
+        constexpr Type Value() const;
+        constexpr bool IsZero() const;
+
+        constexpr FieldElement<1> Squared() const;
+        constexpr FieldElement<1> Inverse() const;
+
+        // The square root x^((p + 1) / 4). Returns false if this is not a square, in which case root is meaningless.
+        constexpr bool TrySquareRoot(FieldElement<1>& root) const;
+
+        // Weak reduction: magnitude 1, but the value may still be at or above p
+        constexpr FieldElement<1> Reduced() const;
+
+        std::array<uint64_t, 5> n;
+
+        // In _DEBUG builds, throw if a limb exceeds the bound for Magnitude
+        constexpr void CheckMagnitude() const;
+    };
+
+    template <unsigned M1, unsigned M2>
+    constexpr FieldElement<M1 + M2> operator +(const FieldElement<M1>& lhs, const FieldElement<M2>& rhs);
+
+    template <unsigned M>
+    constexpr FieldElement<M + 1> operator -(const FieldElement<M>& rhs);
+
+    template <unsigned M1, unsigned M2>
+    constexpr FieldElement<M1 + M2 + 1> operator -(const FieldElement<M1>& lhs, const FieldElement<M2>& rhs);
+
+    template <unsigned M1, unsigned M2>
+    constexpr FieldElement<1> operator *(const FieldElement<M1>& lhs, const FieldElement<M2>& rhs);
+
+    template <unsigned M1, unsigned M2>
+    constexpr FieldElement<1> operator /(const FieldElement<M1>& lhs, const FieldElement<M2>& rhs);
+
+    template <unsigned M1, unsigned M2>
+    constexpr bool operator ==(const FieldElement<M1>& lhs, const FieldElement<M2>& rhs);
+
+    template <unsigned M1, unsigned M2>
+    constexpr bool operator !=(const FieldElement<M1>& lhs, const FieldElement<M2>& rhs);
+}
+
+
+/* Implementation follows */
+
+namespace secp256k1
+{
+namespace Detail
+{
+    static constexpr uint64_t Mask52 = 0xFFFFFFFFFFFFFull;
+    static constexpr uint64_t Mask48 = 0x0FFFFFFFFFFFFull;
+
+    // 2^256 mod p, and 2^260 mod p (the weight of a sixth limb)
+    static constexpr uint64_t Fold256 = 0x1000003D1ull;
+    static constexpr uint64_t Fold260 = 0x1000003D10ull;
+
+    // The limbs of p
+    static constexpr std::array<uint64_t, 5> P = { 0xFFFFEFFFFFC2Full, Mask52, Mask52, Mask52, Mask48 };
+
+    // A 128-bit unsigned accumulator. The portable version builds the product from 32-bit halves.
+#if defined(__SIZEOF_INT128__)
+    using U128 = unsigned __int128;
+    constexpr U128 Multiply(uint64_t a, uint64_t b) { return U128(a) * b; }
+    constexpr uint64_t Low(U128 x) { return static_cast<uint64_t>(x); }
+    constexpr U128 ShiftRight(U128 x, unsigned shift) { return x >> shift; }
+    constexpr U128 Add(U128 x, U128 y) { return x + y; }
+#else
+    struct U128
+    {
+        constexpr U128(uint64_t lo = 0, uint64_t hi = 0) : lo(lo), hi(hi) {}
+        uint64_t lo, hi;
+    };
+    constexpr U128 Add(U128 x, U128 y)
+    {
+        const uint64_t lo = x.lo + y.lo;
+        return { lo, x.hi + y.hi + (lo < x.lo) };
+    }
+    constexpr U128 Multiply(uint64_t a, uint64_t b)
+    {
+        const uint64_t a0 = a & 0xFFFFFFFF, a1 = a >> 32, b0 = b & 0xFFFFFFFF, b1 = b >> 32;
+        const uint64_t p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+        const uint64_t middle = (p00 >> 32) + (p01 & 0xFFFFFFFF) + (p10 & 0xFFFFFFFF);
+        return { (middle << 32) | (p00 & 0xFFFFFFFF), p11 + (p01 >> 32) + (p10 >> 32) + (middle >> 32) };
+    }
+    constexpr uint64_t Low(U128 x) { return x.lo; }
+    constexpr U128 ShiftRight(U128 x, unsigned shift) { return { (x.lo >> shift) | (x.hi << (64 - shift)), x.hi >> shift }; } // 0 < shift < 64
+#endif
+
+    // Fold the bits above 2^256 back in, then carry. Leaves magnitude 1.
+    constexpr std::array<uint64_t, 5> ReduceWeak(std::array<uint64_t, 5> t)
+    {
+        t[1] += t[0] >> 52; t[0] &= Mask52;
+        t[2] += t[1] >> 52; t[1] &= Mask52;
+        t[3] += t[2] >> 52; t[2] &= Mask52;
+        t[4] += t[3] >> 52; t[3] &= Mask52;
+        const uint64_t x = t[4] >> 48;
+        t[4] &= Mask48;
+        t[0] += x * Fold256;
+        t[1] += t[0] >> 52; t[0] &= Mask52;
+        t[2] += t[1] >> 52; t[1] &= Mask52;
+        t[3] += t[2] >> 52; t[2] &= Mask52;
+        t[4] += t[3] >> 52; t[3] &= Mask52;
+        return t;
+    }
+
+    // The unique representative in [0, p)
+    constexpr std::array<uint64_t, 5> ReduceFull(std::array<uint64_t, 5> t)
+    {
+        t = ReduceWeak(t);
+        t = ReduceWeak(t); // Now below 2^256
+
+        const bool atLeastP = t[4] == Mask48 && (t[3] & t[2] & t[1]) == Mask52 && t[0] >= P[0];
+        if (atLeastP)
+        {
+            // Subtract p, i.e. add 2^256 - p and drop bit 256
+            t[0] += Fold256;
+            t[1] += t[0] >> 52; t[0] &= Mask52;
+            t[2] += t[1] >> 52; t[1] &= Mask52;
+            t[3] += t[2] >> 52; t[2] &= Mask52;
+            t[4] += t[3] >> 52; t[3] &= Mask52;
+            t[4] &= Mask48;
+        }
+        return t;
+    }
+
+    constexpr std::array<uint64_t, 5> MultiplyLimbs(const std::array<uint64_t, 5>& a, const std::array<uint64_t, 5>& b)
+    {
+        // Column sums of the schoolbook product. With limbs below 2^56 each is below 2^115.
+        std::array<U128, 9> d = {};
+        for (size_t i = 0; i < 5; ++i)
+            for (size_t j = 0; j < 5; ++j)
+                d[i + j] = Add(d[i + j], Detail::Multiply(a[i], b[j]));
+
+        // Carry the upper columns into 52-bit limbs, then fold them down: limb k + 5 weighs 2^260 = Fold260 mod p
+        std::array<uint64_t, 5> high = {};
+        U128 carry = {};
+        for (size_t k = 5; k < 9; ++k)
+        {
+            const U128 column = Add(d[k], carry);
+            high[k - 5] = Low(column) & Mask52;
+            carry = ShiftRight(column, 52);
+        }
+        high[4] = Low(carry); // Below 2^64
+
+        std::array<uint64_t, 5> t = {};
+        carry = {};
+        for (size_t k = 0; k < 5; ++k)
+        {
+            const U128 column = Add(Add(d[k], carry), Detail::Multiply(high[k], Fold260));
+            t[k] = Low(column) & Mask52;
+            carry = ShiftRight(column, 52);
+        }
+
+        // What is left weighs 2^260 again: fold it into the bottom limbs, then carry
+        const U128 top = Detail::Multiply(Low(carry), Fold260); // The carry is below 2^64
+        U128 column = Add(top, t[0]);
+        t[0] = Low(column) & Mask52;
+        column = Add(ShiftRight(column, 52), t[1]);
+        t[1] = Low(column) & Mask52;
+        t[2] += Low(ShiftRight(column, 52));
+        return ReduceWeak(t);
+    }
+
+    // Between 32-bit words (least significant first) and 52-bit limbs, 26 bits at a time so that nothing overflows
+    constexpr std::array<uint64_t, 5> FromWords(const std::array<uint32_t, 8>& words)
+    {
+        std::array<uint64_t, 5> t = {};
+        uint64_t accumulator = 0;
+        int bitCount = 0;
+        for (size_t half = 0, w = 0; half < 10; ++half)
+        {
+            if (bitCount < 26 && w < words.size())
+            {
+                accumulator |= uint64_t(words[w++]) << bitCount;
+                bitCount += 32;
+            }
+            t[half / 2] |= (accumulator & 0x3FFFFFF) << (26 * (half % 2));
+            accumulator >>= 26;
+            bitCount -= 26;
+        }
+        return t;
+    }
+
+    constexpr std::array<uint32_t, 8> ToWords(const std::array<uint64_t, 5>& t)
+    {
+        std::array<uint32_t, 8> words = {};
+        uint64_t accumulator = 0;
+        int bitCount = 0;
+        for (size_t half = 0, w = 0; half < 10; ++half)
+        {
+            accumulator |= ((t[half / 2] >> (26 * (half % 2))) & 0x3FFFFFF) << bitCount;
+            bitCount += 26;
+            for (; bitCount >= 32 && w < words.size(); bitCount -= 32, accumulator >>= 32)
+                words[w++] = static_cast<uint32_t>(accumulator);
+        }
+        return words;
+    }
+
+    // Limb k of the element must not exceed this for magnitude M
+    constexpr uint64_t LimbBound(unsigned magnitude, size_t k)
+    {
+        return 2 * magnitude * (k == 4 ? Mask48 : Mask52);
+    }
+}
+
+template <unsigned Magnitude>
+constexpr void FieldElement<Magnitude>::CheckMagnitude() const
+{
+#ifdef _DEBUG
+    for (size_t k = 0; k < 5; ++k)
+        if (n[k] > Detail::LimbBound(Magnitude, k))
+            throw std::runtime_error("Field element exceeds its magnitude bound");
+#endif
+}
+
+template <unsigned Magnitude>
+constexpr FieldElement<Magnitude>::FieldElement(const Type& x) : n(Detail::FromWords(x.m_a))
+{
+}
+
+template <unsigned Magnitude>
+template <unsigned M>
+constexpr FieldElement<Magnitude>::FieldElement(const FieldElement<M>& rhs) : n(M <= Magnitude ? rhs.n : Detail::ReduceWeak(rhs.n))
+{
+    CheckMagnitude();
+}
+
+template <unsigned Magnitude>
+constexpr typename FieldElement<Magnitude>::Type FieldElement<Magnitude>::Value() const
+{
+    Type x;
+    x.m_a = Detail::ToWords(Detail::ReduceFull(n));
+    return x;
+}
+
+template <unsigned Magnitude>
+constexpr bool FieldElement<Magnitude>::IsZero() const
+{
+    const auto t = Detail::ReduceFull(n);
+    return (t[0] | t[1] | t[2] | t[3] | t[4]) == 0;
+}
+
+template <unsigned Magnitude>
+constexpr FieldElement<1> FieldElement<Magnitude>::Reduced() const
+{
+    FieldElement<1> rv;
+    rv.n = Detail::ReduceWeak(n);
+    return rv;
+}
+
+template <unsigned Magnitude>
+constexpr FieldElement<1> FieldElement<Magnitude>::Squared() const
+{
+    return *this * *this;
+}
+
+template <unsigned Magnitude>
+constexpr FieldElement<1> FieldElement<Magnitude>::Inverse() const
+{
+    // Fermat: x^(p - 2). The binary expansion of p - 2 has blocks of ones of lengths 223, 22, 1, 2 and 1,
+    // so build x^(2^k - 1) for those k with an addition chain, then slide over the blocks.
+    const FieldElement<1> x = *this;
+    auto squareTimes = [](FieldElement<1> y, int count)
+    {
+        for (int i = 0; i < count; ++i)
+            y = y.Squared();
+        return y;
+    };
+    const FieldElement<1> x2 = x.Squared() * x;
+    const FieldElement<1> x3 = x2.Squared() * x;
+    const FieldElement<1> x6 = squareTimes(x3, 3) * x3;
+    const FieldElement<1> x9 = squareTimes(x6, 3) * x3;
+    const FieldElement<1> x11 = squareTimes(x9, 2) * x2;
+    const FieldElement<1> x22 = squareTimes(x11, 11) * x11;
+    const FieldElement<1> x44 = squareTimes(x22, 22) * x22;
+    const FieldElement<1> x88 = squareTimes(x44, 44) * x44;
+    const FieldElement<1> x176 = squareTimes(x88, 88) * x88;
+    const FieldElement<1> x220 = squareTimes(x176, 44) * x44;
+    const FieldElement<1> x223 = squareTimes(x220, 3) * x3;
+
+    FieldElement<1> t = squareTimes(x223, 23) * x22;
+    t = squareTimes(t, 5) * x;
+    t = squareTimes(t, 3) * x2;
+    return squareTimes(t, 2) * x;
+}
+
+template <unsigned Magnitude>
+constexpr bool FieldElement<Magnitude>::TrySquareRoot(FieldElement<1>& root) const
+{
+    // The binary expansion of (p + 1) / 4 has blocks of ones of lengths 223, 22 and 2,
+    // so reuse the addition chain of Inverse for x^(2^k - 1) and slide over the blocks.
+    const FieldElement<1> x = *this;
+    auto squareTimes = [](FieldElement<1> y, int count)
+    {
+        for (int i = 0; i < count; ++i)
+            y = y.Squared();
+        return y;
+    };
+    const FieldElement<1> x2 = x.Squared() * x;
+    const FieldElement<1> x3 = x2.Squared() * x;
+    const FieldElement<1> x6 = squareTimes(x3, 3) * x3;
+    const FieldElement<1> x9 = squareTimes(x6, 3) * x3;
+    const FieldElement<1> x11 = squareTimes(x9, 2) * x2;
+    const FieldElement<1> x22 = squareTimes(x11, 11) * x11;
+    const FieldElement<1> x44 = squareTimes(x22, 22) * x22;
+    const FieldElement<1> x88 = squareTimes(x44, 44) * x44;
+    const FieldElement<1> x176 = squareTimes(x88, 88) * x88;
+    const FieldElement<1> x220 = squareTimes(x176, 44) * x44;
+    const FieldElement<1> x223 = squareTimes(x220, 3) * x3;
+
+    FieldElement<1> t = squareTimes(x223, 23) * x22;
+    t = squareTimes(t, 6) * x2;
+    root = squareTimes(t, 2);
+    return root.Squared().Value() == x.Value();
+}
+
+template <unsigned M1, unsigned M2>
+constexpr FieldElement<M1 + M2> operator +(const FieldElement<M1>& lhs, const FieldElement<M2>& rhs)
+{
+    FieldElement<M1 + M2> rv;
+    for (size_t k = 0; k < 5; ++k)
+        rv.n[k] = lhs.n[k] + rhs.n[k];
+    rv.CheckMagnitude();
+    return rv;
+}
+
+template <unsigned M>
+constexpr FieldElement<M + 1> operator -(const FieldElement<M>& rhs)
+{
+    // 2(M + 1) p - rhs, limb by limb: each limb of 2(M + 1) p exceeds the corresponding bound for magnitude M
+    rhs.CheckMagnitude();
+    FieldElement<M + 1> rv;
+    for (size_t k = 0; k < 5; ++k)
+        rv.n[k] = 2 * (M + 1) * Detail::P[k] - rhs.n[k];
+    return rv;
+}
+
+template <unsigned M1, unsigned M2>
+constexpr FieldElement<M1 + M2 + 1> operator -(const FieldElement<M1>& lhs, const FieldElement<M2>& rhs)
+{
+    return lhs + -rhs;
+}
+
+template <unsigned M1, unsigned M2>
+constexpr FieldElement<1> operator *(const FieldElement<M1>& lhs, const FieldElement<M2>& rhs)
+{
+    static_assert(M1 <= 8 && M2 <= 8, "Multiplication inputs must have magnitude at most 8: assign to a FieldElement<1> first");
+    lhs.CheckMagnitude();
+    rhs.CheckMagnitude();
+    FieldElement<1> rv;
+    rv.n = Detail::MultiplyLimbs(lhs.n, rhs.n);
+    return rv;
+}
+
+template <unsigned M1, unsigned M2>
+constexpr FieldElement<1> operator /(const FieldElement<M1>& lhs, const FieldElement<M2>& rhs)
+{
+    return FieldElement<1>(lhs) * rhs.Inverse();
+}
+
+template <unsigned M1, unsigned M2>
+constexpr bool operator ==(const FieldElement<M1>& lhs, const FieldElement<M2>& rhs)
+{
+    return Detail::ReduceFull(lhs.n) == Detail::ReduceFull(rhs.n);
+}
+
+template <unsigned M1, unsigned M2>
+constexpr bool operator !=(const FieldElement<M1>& lhs, const FieldElement<M2>& rhs)
+{
+    return !(lhs == rhs);
+}
+}
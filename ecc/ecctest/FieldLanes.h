@@ -0,0 +1,565 @@
+#pragma once
+
+/*
+* Field arithmetic on N independent elements of Fp<Bits, p> at once, for batch work such as normalizing many points.
+*
+* Each element is held as ten 26-bit limbs (radix 2^26, 260 bits) in 64-bit lanes, so a product of two limbs takes 52 bits
+* and a full row of partial products can be accumulated without carrying. Multiplication is Montgomery multiplication
+* with R = 2^260, which works for any odd p. A Batch is converted into Montgomery form once when it is loaded and back
+* once when it is stored, so in between every product or square is a single Montgomery multiplication, and addition
+* and subtraction work on Montgomery forms unchanged.
+*
+* Element<Field, N> is written once over Lanes<N, int64_t> (see Lanes.h). Batches run it with 8 lanes on CPUs with
+* AVX-512 or 4 lanes with AVX2, or use the scalar Fp operators, which are the reference. On GCC and Clang each width is
+* compiled for its instruction set, so one binary carries every path. Lanes only pay off when the scalar operators
+* of the field are slow enough, so the default width is measured once per Fp field at run time (SelectedLaneCount).
+* Other fields, such as the secp256k1::FieldElement coordinates, default to their own scalar operators.
+*/
+
+#include "Fp.h"
+#include "Lanes.h"
+#include "PointBatch.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace FieldLanes
+{
+    constexpr size_t LimbBits = 26;
+    constexpr size_t LimbCount = 10;
+
+    template <typename Field> class Batch;
+
+    // The widest lane count the CPU supports: 8 (AVX-512), 4 (AVX2), or 1 for the scalar operators only
+    size_t WidestLaneCount();
+
+    // The lane count batches of Field use by default: for Fp, the widest if that measured faster than the scalar operators,
+    // and otherwise 1
+    template <typename Field> size_t SelectedLaneCount();
+
+    // N elements of Field in radix 2^26 lanes. Values are always fully reduced, in [0, p).
+    template <typename Field, size_t N>
+    class Element
+    {
+    public:
+        using Word = Lanes<N, int64_t>;
+
+        Element() = default;
+
+        // Load the N elements of a lane batch starting at index, which must be a multiple of N, or store to them
+        static Element Load(const Batch<Field>& batch, size_t index);
+        void Store(Batch<Field>& batch, size_t index) const;
+
+        // x * R mod p, and back
+        Element ToMontgomery() const { return MontgomeryMultiply(*this, s_R2); }
+        Element FromMontgomery() const { return MontgomeryMultiply(*this, s_one); }
+
+        friend Element operator +(const Element& lhs, const Element& rhs) { return Element::Add(lhs, rhs); }
+        friend Element operator -(const Element& lhs, const Element& rhs) { return Element::Subtract(lhs, rhs); }
+
+        // Montgomery product: lhs * rhs / R mod p
+        static Element MontgomeryMultiply(const Element& lhs, const Element& rhs);
+
+        // Lane-wise product and square of Montgomery forms, which is the Montgomery form of the product
+        friend Element operator *(const Element& lhs, const Element& rhs) { return MontgomeryMultiply(lhs, rhs); }
+        Element Squared() const { return MontgomeryMultiply(*this, *this); }
+
+    private:
+        static Element Add(const Element& lhs, const Element& rhs);
+        static Element Subtract(const Element& lhs, const Element& rhs);
+
+        // Carry each limb into the next, leaving all but the top limb in [0, 2^26)
+        void Normalize();
+
+        // Given a normalized value in [0, 2p), subtract p if the value is at least p
+        void ReduceOnce();
+
+        static Element Broadcast(const std::array<int64_t, LimbCount>& limbs);
+
+        static const Element s_p;
+        static const Element s_R2;  // R^2 mod p
+        static const Element s_one;
+        static const int64_t s_pInv; // -p^-1 mod 2^26
+
+        std::array<Word, LimbCount> limbs;
+    };
+
+    // Many elements of Field, held the way the batch's lane count works on them: as they are for one lane, otherwise
+    // as rows of radix 2^26 limbs in Montgomery form, padded with zeros to a multiple of the widest lane count
+    template <typename Field>
+    class Batch
+    {
+    public:
+        explicit Batch(size_t count, size_t laneCount);
+        explicit Batch(std::span<const Field> elements, size_t laneCount);
+        explicit Batch(const FpBatch<Field>& elements, size_t laneCount);
+        explicit Batch(size_t count) : Batch(count, SelectedLaneCount<Field>()) {}
+        explicit Batch(std::span<const Field> elements) : Batch(elements, SelectedLaneCount<Field>()) {}
+        explicit Batch(const FpBatch<Field>& elements) : Batch(elements, SelectedLaneCount<Field>()) {}
+
+        size_t size() const { return count; }
+        size_t LaneCount() const { return laneCount; }
+        size_t Stride() const { return stride; }
+
+        // The elements, for one lane
+        std::span<Field> Elements() { return scalars; }
+        std::span<const Field> Elements() const { return scalars; }
+
+        // Limb k of every element, for more than one lane
+        std::span<int64_t> Limbs(size_t k) { return { &limbs[k * stride], stride }; }
+        std::span<const int64_t> Limbs(size_t k) const { return { &limbs[k * stride], stride }; }
+
+        void Load(std::span<const Field> elements);
+        void Load(const FpBatch<Field>& elements);
+        void Store(std::span<Field> elements) const;
+
+    private:
+        template <typename Get> void LoadWith(Get get);
+
+        size_t count = 0;
+        size_t laneCount = 1;
+        size_t stride = 0;
+        std::vector<Field> scalars;
+        std::vector<int64_t> limbs;
+    };
+
+    struct Statistics
+    {
+        uint64_t count = 0;
+        size_t laneCount = 0;
+        double seconds = 0;
+
+        double OperationsPerSecond() const
+        {
+            return seconds > 0 ? count / seconds : 0;
+        }
+    };
+
+    // out[i] = a[i] op b[i]. The batches must have the same size and lane count; out may be a or b.
+    template <typename Field> void Add(const Batch<Field>& a, const Batch<Field>& b, Batch<Field>& out);
+    template <typename Field> void Subtract(const Batch<Field>& a, const Batch<Field>& b, Batch<Field>& out);
+    template <typename Field> void Multiply(const Batch<Field>& a, const Batch<Field>& b, Batch<Field>& out);
+    template <typename Field> void Square(const Batch<Field>& a, Batch<Field>& out);
+
+    // Time repeated batch multiplication of count elements at the given lane width, excluding the conversions.
+    // Reports multiplications per second.
+    template <typename Field> Statistics BenchmarkMultiply(size_t count, size_t laneCount);
+}
+
+
+/* Implementation follows */
+
+// Compile a function for the given instruction set, with everything it calls inlined into it
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FIELDLANES_TARGET(isa) __attribute__((target(isa), flatten))
+#else
+#define FIELDLANES_TARGET(isa)
+#endif
+
+namespace FieldLanes
+{
+namespace Detail
+{
+    constexpr size_t MaxLaneCount = 8;
+
+    template <typename Field> struct IsFp : std::false_type {};
+    template <size_t Bits, UIntW<Bits> p> struct IsFp<Fp<Bits, p>> : std::true_type {};
+
+    template <typename Field>
+    constexpr std::array<int64_t, LimbCount> ToLimbs(const typename Field::Type& x)
+    {
+        static_assert(Field::Type::BitCount <= LimbBits * LimbCount - 2, "Field too wide for ten 26-bit limbs");
+        constexpr size_t WordCount = Field::Type::ElementCount;
+        std::array<int64_t, LimbCount> rv = {};
+        for (size_t i = 0, bit = 0; i < LimbCount; ++i, bit += LimbBits)
+        {
+            // The limb lies within two consecutive 32-bit words
+            const size_t k = bit / 32;
+            uint64_t window = k < WordCount ? x.m_a[k] : 0;
+            if (k + 1 < WordCount)
+                window |= uint64_t(x.m_a[k + 1]) << 32;
+            rv[i] = static_cast<int64_t>((window >> (bit % 32)) & ((uint64_t(1) << LimbBits) - 1));
+        }
+        return rv;
+    }
+
+    // The inverse of ToLimbs, for normalized limbs
+    template <typename Field>
+    typename Field::Type FromLimbs(const std::array<int64_t, LimbCount>& limbs)
+    {
+        typename Field::Type x;
+        for (size_t i = 0; i < LimbCount; ++i)
+        {
+            const uint64_t limb = static_cast<uint64_t>(limbs[i]);
+            const size_t bit = i * LimbBits;
+            for (size_t k = bit / 32; k < Field::Type::ElementCount && 32 * k < bit + LimbBits; ++k)
+                x.m_a[k] |= static_cast<uint32_t>(32 * k >= bit ? limb >> (32 * k - bit) : limb << (bit - 32 * k));
+        }
+        return x;
+    }
+
+    // Call op(std::integral_constant<size_t, N>()) with N the given lane count, compiled for the instruction set of that width
+    template <typename Op>
+    FIELDLANES_TARGET("avx512f,avx512dq") void Run8(Op op)
+    {
+        op(std::integral_constant<size_t, 8>());
+    }
+
+    template <typename Op>
+    FIELDLANES_TARGET("avx2") void Run4(Op op)
+    {
+        op(std::integral_constant<size_t, 4>());
+    }
+
+    template <typename Op>
+    void Dispatch(size_t laneCount, Op op)
+    {
+        if (laneCount == 8)
+            Run8(op);
+        else if (laneCount == 4)
+            Run4(op);
+        else
+            throw std::invalid_argument("Lane count must be 1, 4 or 8");
+    }
+
+    // Apply laneOp to every group of lanes of the batches, or scalarOp to every element for one lane
+    template <typename Field, typename LaneOp, typename ScalarOp>
+    void Apply(const Batch<Field>& a, const Batch<Field>& b, Batch<Field>& out, LaneOp laneOp, ScalarOp scalarOp)
+    {
+        if (a.size() != out.size() || b.size() != out.size())
+            throw std::invalid_argument("Batch size mismatch");
+        if (a.LaneCount() != out.LaneCount() || b.LaneCount() != out.LaneCount())
+            throw std::invalid_argument("Batch lane count mismatch");
+
+        if (out.LaneCount() == 1)
+        {
+            const auto x = a.Elements(), y = b.Elements();
+            const auto z = out.Elements();
+            for (size_t i = 0; i < z.size(); ++i)
+                z[i] = scalarOp(x[i], y[i]);
+            return;
+        }
+        Dispatch(out.LaneCount(), [&](auto width)
+        {
+            constexpr size_t N = decltype(width)::value;
+            for (size_t i = 0; i < out.Stride(); i += N)
+                laneOp(Element<Field, N>::Load(a, i), Element<Field, N>::Load(b, i)).Store(out, i);
+        });
+    }
+}
+
+template <typename Field, size_t N>
+Element<Field, N> Element<Field, N>::Broadcast(const std::array<int64_t, LimbCount>& limbs)
+{
+    Element e;
+    for (size_t i = 0; i < LimbCount; ++i)
+        e.limbs[i] = Word(limbs[i]);
+    return e;
+}
+
+template <typename Field, size_t N>
+const Element<Field, N> Element<Field, N>::s_p = Broadcast(Detail::ToLimbs<Field>(Field::Modulus));
+
+template <typename Field, size_t N>
+const Element<Field, N> Element<Field, N>::s_R2 = []()
+{
+    // 2^520 mod p by doubling
+    Field x = typename Field::Base(1);
+    for (size_t i = 0; i < 2 * LimbBits * LimbCount; ++i)
+        x = x + x;
+    return Broadcast(Detail::ToLimbs<Field>(x.Value()));
+}();
+
+template <typename Field, size_t N>
+const Element<Field, N> Element<Field, N>::s_one = Broadcast({ 1 });
+
+template <typename Field, size_t N>
+const int64_t Element<Field, N>::s_pInv = []()
+{
+    // Newton's iteration doubles the number of correct low bits of p^-1 each time
+    const uint32_t p0 = Field::Modulus.m_a[0];
+    uint32_t inverse = 1;
+    for (int i = 0; i < 5; ++i)
+        inverse *= 2 - p0 * inverse;
+    return static_cast<int64_t>((0u - inverse) & ((1u << LimbBits) - 1));
+}();
+
+template <typename Field, size_t N>
+Element<Field, N> Element<Field, N>::Load(const Batch<Field>& batch, size_t index)
+{
+    Element e;
+    for (size_t i = 0; i < LimbCount; ++i)
+        e.limbs[i] = Word::Load(&batch.Limbs(i)[index]);
+    return e;
+}
+
+template <typename Field, size_t N>
+void Element<Field, N>::Store(Batch<Field>& batch, size_t index) const
+{
+    for (size_t i = 0; i < LimbCount; ++i)
+        limbs[i].Store(&batch.Limbs(i)[index]);
+}
+
+template <typename Field, size_t N>
+void Element<Field, N>::Normalize()
+{
+    const Word mask((int64_t(1) << LimbBits) - 1);
+    for (size_t i = 0; i + 1 < LimbCount; ++i)
+    {
+        limbs[i + 1] += limbs[i] >> LimbBits; // Arithmetic shift, so negative limbs borrow
+        limbs[i] = limbs[i] & mask;
+    }
+}
+
+template <typename Field, size_t N>
+void Element<Field, N>::ReduceOnce()
+{
+    Element difference;
+    for (size_t i = 0; i < LimbCount; ++i)
+        difference.limbs[i] = limbs[i] - s_p.limbs[i];
+    difference.Normalize();
+
+    // All ones in the lanes where the difference is negative, i.e. the value was already below p
+    const Word keep = difference.limbs[LimbCount - 1] >> 63;
+    for (size_t i = 0; i < LimbCount; ++i)
+        limbs[i] = (limbs[i] & keep) | (difference.limbs[i] & ~keep);
+}
+
+template <typename Field, size_t N>
+Element<Field, N> Element<Field, N>::Add(const Element& lhs, const Element& rhs)
+{
+    Element sum;
+    for (size_t i = 0; i < LimbCount; ++i)
+        sum.limbs[i] = lhs.limbs[i] + rhs.limbs[i];
+    sum.Normalize();
+    sum.ReduceOnce();
+    return sum;
+}
+
+template <typename Field, size_t N>
+Element<Field, N> Element<Field, N>::Subtract(const Element& lhs, const Element& rhs)
+{
+    Element difference;
+    for (size_t i = 0; i < LimbCount; ++i)
+        difference.limbs[i] = lhs.limbs[i] - rhs.limbs[i];
+    difference.Normalize();
+
+    // Add p back in the lanes that went negative
+    const Word negative = difference.limbs[LimbCount - 1] >> 63;
+    for (size_t i = 0; i < LimbCount; ++i)
+        difference.limbs[i] += s_p.limbs[i] & negative;
+    difference.Normalize();
+    return difference;
+}
+
+template <typename Field, size_t N>
+Element<Field, N> Element<Field, N>::MontgomeryMultiply(const Element& lhs, const Element& rhs)
+{
+    // Operand scanning, one limb of lhs per step. Each step adds lhs_i * rhs + m * p, which is divisible by 2^26,
+    // then shifts down by one limb. Only the lowest limb is carried each step: the others stay below 20 * 2^52.
+    const Word mask((int64_t(1) << LimbBits) - 1);
+    std::array<Word, LimbCount> t = {};
+    for (size_t i = 0; i < LimbCount; ++i)
+    {
+        for (size_t j = 0; j < LimbCount; ++j)
+            t[j] += lhs.limbs[i] * rhs.limbs[j];
+        const Word m = ((t[0] & mask) * Word(s_pInv)) & mask;
+        for (size_t j = 0; j < LimbCount; ++j)
+            t[j] += m * s_p.limbs[j];
+
+        const Word carry = t[0] >> LimbBits;
+        for (size_t j = 0; j + 1 < LimbCount; ++j)
+            t[j] = t[j + 1];
+        t[LimbCount - 1] = Word(0);
+        t[0] += carry;
+    }
+
+    // The result is below 2p
+    Element product;
+    product.limbs = t;
+    product.Normalize();
+    product.ReduceOnce();
+    return product;
+}
+
+template <typename Field>
+Batch<Field>::Batch(size_t count, size_t laneCount)
+    : count(count), laneCount(laneCount)
+{
+    if (laneCount == 1)
+    {
+        scalars.resize(count);
+        return;
+    }
+    if (laneCount != 4 && laneCount != 8)
+        throw std::invalid_argument("Lane count must be 1, 4 or 8");
+    stride = (count + Detail::MaxLaneCount - 1) / Detail::MaxLaneCount * Detail::MaxLaneCount;
+    limbs.resize(LimbCount * stride);
+}
+
+template <typename Field>
+Batch<Field>::Batch(std::span<const Field> elements, size_t laneCount) : Batch(elements.size(), laneCount)
+{
+    Load(elements);
+}
+
+template <typename Field>
+Batch<Field>::Batch(const FpBatch<Field>& elements, size_t laneCount) : Batch(elements.size(), laneCount)
+{
+    Load(elements);
+}
+
+template <typename Field>
+template <typename Get>
+void Batch<Field>::LoadWith(Get get)
+{
+    if (laneCount == 1)
+    {
+        for (size_t i = 0; i < count; ++i)
+            scalars[i] = get(i);
+        return;
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const auto elementLimbs = Detail::ToLimbs<Field>(get(i).Value());
+        for (size_t k = 0; k < LimbCount; ++k)
+            limbs[k * stride + i] = elementLimbs[k];
+    }
+    Detail::Dispatch(laneCount, [this](auto width)
+    {
+        constexpr size_t N = decltype(width)::value;
+        for (size_t i = 0; i < stride; i += N)
+            Element<Field, N>::Load(*this, i).ToMontgomery().Store(*this, i);
+    });
+}
+
+template <typename Field>
+void Batch<Field>::Load(std::span<const Field> elements)
+{
+    if (elements.size() != count)
+        throw std::invalid_argument("Batch size mismatch");
+    LoadWith([elements](size_t i) { return elements[i]; });
+}
+
+template <typename Field>
+void Batch<Field>::Load(const FpBatch<Field>& elements)
+{
+    if (elements.size() != count)
+        throw std::invalid_argument("Batch size mismatch");
+    LoadWith([&elements](size_t i) { return elements.Get(i); });
+}
+
+template <typename Field>
+void Batch<Field>::Store(std::span<Field> elements) const
+{
+    if (elements.size() != count)
+        throw std::invalid_argument("Batch size mismatch");
+    if (laneCount == 1)
+    {
+        std::copy(scalars.begin(), scalars.end(), elements.begin());
+        return;
+    }
+
+    Batch plain = *this;
+    Detail::Dispatch(laneCount, [&plain](auto width)
+    {
+        constexpr size_t N = decltype(width)::value;
+        for (size_t i = 0; i < plain.stride; i += N)
+            Element<Field, N>::Load(plain, i).FromMontgomery().Store(plain, i);
+    });
+    for (size_t i = 0; i < count; ++i)
+    {
+        std::array<int64_t, LimbCount> elementLimbs;
+        for (size_t k = 0; k < LimbCount; ++k)
+            elementLimbs[k] = plain.limbs[k * stride + i];
+        elements[i] = Field(Detail::FromLimbs<Field>(elementLimbs));
+    }
+}
+
+inline size_t WidestLaneCount()
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    static const size_t laneCount = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq") ? 8 : __builtin_cpu_supports("avx2") ? 4 : 1;
+    return laneCount;
+#else
+    return 4; // Plain per-lane loops, left to the auto-vectorizer
+#endif
+}
+
+template <typename Field>
+size_t SelectedLaneCount()
+{
+    // Only the generic Fp operators are slow enough for lanes to win. Dedicated fields such as secp256k1::FieldElement
+    // multiply faster on their own than the lanes do, so they are not measured at all.
+    if constexpr (!Detail::IsFp<Field>::value)
+        return 1;
+    else
+    {
+        static const size_t laneCount = []()
+        {
+            const size_t widest = WidestLaneCount();
+            if (widest == 1)
+                return widest;
+            constexpr size_t CalibrationCount = 256;
+            const double laneRate = BenchmarkMultiply<Field>(CalibrationCount, widest).OperationsPerSecond();
+            const double scalarRate = BenchmarkMultiply<Field>(CalibrationCount, 1).OperationsPerSecond();
+            return laneRate > scalarRate ? widest : size_t(1);
+        }();
+        return laneCount;
+    }
+}
+
+template <typename Field>
+void Add(const Batch<Field>& a, const Batch<Field>& b, Batch<Field>& out)
+{
+    Detail::Apply(a, b, out, [](const auto& x, const auto& y) { return x + y; }, [](const Field& x, const Field& y) { return x + y; });
+}
+
+template <typename Field>
+void Subtract(const Batch<Field>& a, const Batch<Field>& b, Batch<Field>& out)
+{
+    Detail::Apply(a, b, out, [](const auto& x, const auto& y) { return x - y; }, [](const Field& x, const Field& y) { return x - y; });
+}
+
+template <typename Field>
+void Multiply(const Batch<Field>& a, const Batch<Field>& b, Batch<Field>& out)
+{
+    Detail::Apply(a, b, out, [](const auto& x, const auto& y) { return x * y; }, [](const Field& x, const Field& y) { return x * y; });
+}
+
+template <typename Field>
+void Square(const Batch<Field>& a, Batch<Field>& out)
+{
+    Detail::Apply(a, a, out, [](const auto& x, const auto&) { return x.Squared(); }, [](const Field& x, const Field&) { return x.Squared(); });
+}
+
+template <typename Field>
+Statistics BenchmarkMultiply(size_t count, size_t laneCount)
+{
+    std::vector<Field> a(count), b(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        a[i] = Field(typename Field::Base(2 * i + 3)).Squared().Squared();
+        b[i] = Field(typename Field::Base(5 * i + 7)).Squared().Squared();
+    }
+    Batch<Field> x(a, laneCount), y(b, laneCount);
+
+    Statistics statistics;
+    statistics.laneCount = laneCount;
+    const auto start = std::chrono::steady_clock::now();
+    for (int repeat = 0; repeat < 4; ++repeat)
+        Multiply(x, y, x);
+    statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    statistics.count = 4 * count;
+    return statistics;
+}
+}
+
+#undef FIELDLANES_TARGET
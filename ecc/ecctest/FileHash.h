@@ -0,0 +1,219 @@
+#pragma once
+
+/*
+* Hashing files of any size with bounded memory.
+*
+* The file is streamed into an incremental hasher (SHA256::Hasher or RIPEMD160::Hasher) in one of two ways:
+*  - Mapped: the file is mapped a window at a time and the hasher reads straight from the page cache, with no copy.
+*    The kernel is told to expect sequential access, and the next window is requested before the current one
+*    is hashed, so reading overlaps with hashing. POSIX only.
+*  - Buffered: a reader thread fills one buffer while the hasher consumes the other. Works everywhere, including on pipes.
+*/
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace FileHash
+{
+    enum class Method
+    {
+        Automatic,  // Mapped where possible, otherwise Buffered
+        Mapped,
+        Buffered
+    };
+
+    struct Statistics
+    {
+        uint64_t bytes = 0;
+        double seconds = 0;
+
+        double MegabytesPerSecond() const
+        {
+            return seconds > 0 ? bytes / seconds / 1e6 : 0;
+        }
+    };
+
+    // Stream the file at path through a Hasher, and return the hash
+    template <typename Hasher>
+    auto Compute(const std::string& path, Method method = Method::Automatic, Statistics* statistics = nullptr);
+}
+
+
+/* Implementation follows */
+
+namespace FileHash
+{
+namespace Detail
+{
+    constexpr size_t WindowBytes = 64 << 20; // Size of each mapped window. A multiple of any page size.
+    constexpr size_t BufferBytes = 4 << 20;  // Size of each of the two read buffers
+
+#if defined(__unix__) || defined(__APPLE__)
+    struct MappedWindow
+    {
+        MappedWindow(int fd, uint64_t offset, size_t size) : size(size)
+        {
+            data = size == 0 ? nullptr : mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(offset));
+            if (data == MAP_FAILED)
+                data = nullptr;
+            else if (data != nullptr)
+            {
+                madvise(data, size, MADV_SEQUENTIAL);
+                madvise(data, size, MADV_WILLNEED); // Start reading now
+            }
+        }
+        ~MappedWindow()
+        {
+            if (data != nullptr)
+                munmap(data, size);
+        }
+        MappedWindow(const MappedWindow&) = delete;
+        MappedWindow& operator =(const MappedWindow&) = delete;
+
+        void* data;
+        size_t size;
+    };
+#endif
+
+    // Returns false, without consuming anything, if the file can't be mapped (e.g. it isn't a regular file)
+    template <typename Consume>
+    inline bool ReadMapped(const std::string& path, Consume& consume)
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        struct FileDescriptor
+        {
+            ~FileDescriptor() { if (fd >= 0) close(fd); }
+            int fd;
+        } file = { open(path.c_str(), O_RDONLY) };
+        if (file.fd < 0)
+            throw std::runtime_error("Cannot open " + path);
+
+        struct stat status;
+        if (fstat(file.fd, &status) != 0 || !S_ISREG(status.st_mode))
+            return false;
+        const uint64_t fileSize = static_cast<uint64_t>(status.st_size);
+
+        auto windowSize = [&](uint64_t offset) { return static_cast<size_t>(std::min<uint64_t>(WindowBytes, fileSize - offset)); };
+        auto current = std::make_unique<MappedWindow>(file.fd, 0, windowSize(0));
+        if (fileSize > 0 && current->data == nullptr)
+            return false;
+
+        for (uint64_t offset = 0; offset < fileSize; offset += WindowBytes)
+        {
+            // Map the next window before hashing this one, so that its pages are read in the meantime
+            const uint64_t nextOffset = offset + WindowBytes;
+            auto next = nextOffset < fileSize ? std::make_unique<MappedWindow>(file.fd, nextOffset, windowSize(nextOffset)) : nullptr;
+            if (next && next->data == nullptr)
+                throw std::runtime_error("Cannot map " + path);
+
+            consume(static_cast<const unsigned char*>(current->data), current->size);
+            current = std::move(next);
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    template <typename Consume>
+    inline void ReadBuffered(const std::string& path, Consume& consume)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            throw std::runtime_error("Cannot open " + path);
+
+        std::array<std::vector<char>, 2> buffers = { std::vector<char>(BufferBytes), std::vector<char>(BufferBytes) };
+        std::array<size_t, 2> sizes = {};
+        std::array<bool, 2> full = {}; // Buffer i has been filled by the reader and not yet consumed
+        std::mutex mutex;
+        std::condition_variable changed;
+
+        // The reader fills the buffers alternately, finishing with an empty buffer to mark the end of the file
+        std::thread reader([&]()
+        {
+            for (size_t i = 0; ; i ^= 1)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    changed.wait(lock, [&]() { return !full[i]; });
+                }
+                file.read(buffers[i].data(), buffers[i].size());
+                const size_t bytesRead = static_cast<size_t>(file.gcount());
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    sizes[i] = bytesRead;
+                    full[i] = true;
+                }
+                changed.notify_all();
+                if (bytesRead == 0)
+                    break;
+            }
+        });
+
+        for (size_t i = 0; ; i ^= 1)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]() { return full[i]; });
+            }
+            if (sizes[i] == 0)
+                break;
+            consume(reinterpret_cast<const unsigned char*>(buffers[i].data()), sizes[i]);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                full[i] = false;
+            }
+            changed.notify_all();
+        }
+        reader.join();
+
+        if (file.bad())
+            throw std::runtime_error("Error reading " + path);
+    }
+}
+
+template <typename Hasher>
+inline auto Compute(const std::string& path, Method method, Statistics* statistics)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    Hasher hasher;
+    uint64_t bytes = 0;
+    auto consume = [&](const unsigned char* data, size_t size)
+    {
+        hasher.Update(data, size);
+        bytes += size;
+    };
+
+    if (method == Method::Buffered || !Detail::ReadMapped(path, consume))
+    {
+        if (method == Method::Mapped)
+            throw std::runtime_error("Cannot map " + path);
+        Detail::ReadBuffered(path, consume);
+    }
+    const auto hash = hasher.Finalize();
+
+    if (statistics != nullptr)
+    {
+        statistics->bytes = bytes;
+        statistics->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    return hash;
+}
+}
@@ -2,6 +2,10 @@
 
 #include "Wide.h"
 
+#include <span>
+#include <stdexcept>
+#include <vector>
+
 namespace ModuloArithmetic
 {
     template <size_t Bits>
@@ -98,6 +102,27 @@ namespace ModuloArithmetic
         const auto s = InvertModuloOdd(b, p);
         return MultiplyModuloM(s, a, p);
     }
+
+    // Reduce a double-width x modulo M = 2^Bits - c, for M close to 2^Bits (e.g. both secp256k1 moduli).
+    // Since 2^Bits = c (mod M), the high half folds down as hi * c + lo until it fits in Bits,
+    // which takes a few multiplications by c instead of a bitwise long division.
+    template <size_t Bits>
+    constexpr UIntW<Bits> ReduceFolding(UIntW<2 * Bits> x, const UIntW<Bits>& c, const UIntW<Bits>& M)
+    {
+        static_assert(UIntW<2 * Bits>::ElementCount == 2 * UIntW<Bits>::ElementCount);
+        while (true)
+        {
+            UIntW<Bits> high;
+            std::copy(x.m_a.begin() + UIntW<Bits>::ElementCount, x.m_a.end(), high.m_a.begin());
+            if (high.IsZero())
+                break;
+            x = (high * c).AddTruncate(x.template Truncate<Bits>());
+        }
+        UIntW<Bits> r = x.template Truncate<Bits>();
+        while (r >= M)
+            r -= M;
+        return r;
+    }
 }
 
 namespace Parse
@@ -161,29 +186,33 @@ public:
     using Array = typename Type::Array;
     //static constexpr Type p = Parse::GetUIntArray<Base>(p0x);
     static_assert(p.IsOdd());
+    static constexpr Type Modulus = p;
+
+    // 2^Bits - p. When it is at most about half the width of p, products are reduced by folding (see ReduceFolding).
+    static constexpr Type Complement = p.TwosComplement();
+    static constexpr bool IsFoldable = Complement.ActualBitCount() <= Bits / 2 + 2;
 
     constexpr Fp() {}
     constexpr Fp(const Base& rhs) : Fp(Type{ rhs }) {}
     constexpr Fp(const Array& rhs) : Fp(Type{ rhs }) {}
     template <size_t RBits, UIntW<Bits> q> constexpr Fp(const Fp<RBits, q>& rhs) : Fp(rhs.x) {}
-    constexpr Fp(const Fp& rhs) : x(rhs.x) {}
-    constexpr Fp(Fp&& rhs) : x(std::move(rhs.x)) {}
+    constexpr Fp(const Fp&) = default;
     constexpr Fp(const Type& rhs) : x(rhs) 
     {
         if (x >= p)
             x = x.DivideUnsignedQR(p).second;
     }
 
-    Fp& operator =(const Fp& rhs)
+    constexpr Fp& operator =(const Fp&) = default;
+
+    constexpr const Type& Value() const
     {
-        x = rhs.x;
-        return *this;
+        return x;
     }
 
-    Fp& operator =(Fp&& rhs)
+    constexpr bool IsZero() const
     {
-        x = std::move(rhs.x);
-        return *this;
+        return x.IsZero();
     }
 
     bool constexpr operator !=(const Fp& rhs) const
@@ -213,12 +242,18 @@ public:
 
     friend constexpr Fp operator *(const Fp& lhs, const Fp& rhs)
     {
-        return ModuloArithmetic::MultiplyModuloM(lhs.x, rhs.x, p);
+        if constexpr (IsFoldable)
+            return ModuloArithmetic::ReduceFolding(lhs.x * rhs.x, Complement, p);
+        else
+            return ModuloArithmetic::MultiplyModuloM(lhs.x, rhs.x, p);
     }
 
     constexpr Fp Squared() const
     {
-        return ModuloArithmetic::SquareModuloM(x, p);
+        if constexpr (IsFoldable)
+            return ModuloArithmetic::ReduceFolding(x.Squared(), Complement, p);
+        else
+            return ModuloArithmetic::SquareModuloM(x, p);
     }
 
     friend constexpr Fp operator /(const Fp& lhs, const Fp& rhs)
@@ -231,6 +266,23 @@ public:
         return ModuloArithmetic::InvertModuloOdd(x, p);
     }
 
+    // For p = 3 (mod 4), the square root x^((p + 1) / 4), by square-and-multiply.
+    // Returns false if this is not a square, i.e. the candidate root does not square back to it.
+    constexpr bool TrySquareRoot(Fp& root) const
+    {
+        static_assert((p.m_a[0] & 3) == 3, "Square roots are only implemented for p = 3 (mod 4)");
+        constexpr Type exponent = (p >> 2) + Type(1u); // (p + 1) / 4 without overflow
+        Fp y = 1u;
+        for (size_t i = exponent.ActualBitCount(); i-- > 0; )
+        {
+            y = y.Squared();
+            if (exponent.GetBit(i))
+                y = y * *this;
+        }
+        root = y;
+        return y.Squared() == *this;
+    }
+
     friend constexpr std::ostream& operator <<(std::ostream& s, const Fp& rhs)
     {
         return s << rhs.x;
@@ -243,3 +295,30 @@ public:
 
     Type x;
 };
+
+// Invert every element in place with one inversion and 3 (n - 1) multiplications (Montgomery's trick).
+// Works for any field type with the same operators as Fp, e.g. secp256k1::FieldElement<1>. No element may be zero.
+template <typename Field>
+void InvertBatch(std::span<Field> values)
+{
+    if (values.empty())
+        return;
+
+    // prefix[i] = values[0] * ... * values[i]
+    std::vector<Field> prefix(values.size());
+    prefix[0] = values[0];
+    for (size_t i = 1; i < values.size(); ++i)
+        prefix[i] = prefix[i - 1] * values[i];
+    if (prefix.back().IsZero())
+        throw std::invalid_argument("Cannot invert zero");
+
+    // Peel off one element at a time: inverse = 1 / (values[0] * ... * values[i])
+    Field inverse = prefix.back().Inverse();
+    for (size_t i = values.size() - 1; i > 0; --i)
+    {
+        const Field value = values[i];
+        values[i] = inverse * prefix[i - 1];
+        inverse = inverse * value;
+    }
+    values[0] = inverse;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+// HMAC-SHA256
+// Implemented from the spec at https://datatracker.ietf.org/doc/html/rfc2104
+
+#include "SHA256.h"
+
+#include <span>
+
+namespace HMAC
+{
+    // HMAC-SHA256 with one key. The hash states after the inner and outer padded key blocks are computed once,
+    // on construction, so each message costs two compressions fewer than HMAC from scratch.
+    class Key
+    {
+    public:
+        // Keys longer than a block are hashed first, as the spec requires
+        explicit constexpr Key(std::span<const uint8_t> key);
+
+        // A 32-byte key given as big-endian words, e.g. an earlier HMAC result
+        explicit constexpr Key(const SHA256::Hash& key);
+
+        constexpr SHA256::Hash Compute(std::span<const uint8_t> message) const;
+
+        // A 32-byte message given as big-endian words: one compression for the inner hash and one for the outer
+        constexpr SHA256::Hash Compute(const SHA256::Hash& message) const;
+
+        // Incremental form: Update the inner hasher with the message in pieces, then Finalize.
+        // A partly updated inner hasher can be copied, to share a common message prefix.
+        constexpr SHA256::Hasher InnerHasher() const { return SHA256::Hasher(inner, 64); }
+        constexpr SHA256::Hash Finalize(SHA256::Hasher innerHasher) const;
+
+    private:
+        constexpr void SetKeyBlock(const std::array<uint32_t, 16>& keyBlock);
+
+        SHA256::Hash inner = {}, outer = {}; // The hash states after the key XOR ipad and XOR opad blocks
+    };
+
+    constexpr SHA256::Hash Compute(std::span<const uint8_t> key, std::span<const uint8_t> message);
+}
+
+
+/* Implementation follows */
+
+namespace HMAC
+{
+namespace Detail
+{
+    constexpr uint32_t InnerPad = 0x36363636;
+    constexpr uint32_t OuterPad = 0x5c5c5c5c;
+
+    // Hash a 32-byte message, as words, that follows one 64-byte block already hashed into state
+    constexpr SHA256::Hash HashAfterBlock(const SHA256::Hash& state, const SHA256::Hash& message)
+    {
+        std::array<uint32_t, 16> M = {};
+        std::copy(message.begin(), message.end(), M.begin());
+        M[8] = 0x80000000;
+        M[15] = (64 + 32) * 8; // Length in bits, including the block before
+        SHA256::Hash H = state;
+        SHA256::Detail::Schedule W = {};
+        SHA256::Detail::Process16WordBlock(&M[0], W, H);
+        return H;
+    }
+}
+
+constexpr Key::Key(std::span<const uint8_t> key)
+{
+    std::array<uint32_t, 16> keyBlock = {};
+    if (key.size() > 64)
+    {
+        const SHA256::Hash hash = SHA256::Compute(key.data(), key.size());
+        std::copy(hash.begin(), hash.end(), keyBlock.begin());
+    }
+    else
+    {
+        for (size_t i = 0; i < key.size(); ++i)
+            keyBlock[i / 4] |= uint32_t(key[i]) << (24 - 8 * (i % 4));
+    }
+    SetKeyBlock(keyBlock);
+}
+
+constexpr Key::Key(const SHA256::Hash& key)
+{
+    std::array<uint32_t, 16> keyBlock = {};
+    std::copy(key.begin(), key.end(), keyBlock.begin());
+    SetKeyBlock(keyBlock);
+}
+
+constexpr void Key::SetKeyBlock(const std::array<uint32_t, 16>& keyBlock)
+{
+    std::array<uint32_t, 16> M = {};
+    SHA256::Detail::Schedule W = {};
+
+    for (size_t i = 0; i < M.size(); ++i)
+        M[i] = keyBlock[i] ^ Detail::InnerPad;
+    inner = SHA256::Detail::s_initialHash;
+    SHA256::Detail::Process16WordBlock(&M[0], W, inner);
+
+    for (size_t i = 0; i < M.size(); ++i)
+        M[i] = keyBlock[i] ^ Detail::OuterPad;
+    outer = SHA256::Detail::s_initialHash;
+    SHA256::Detail::Process16WordBlock(&M[0], W, outer);
+}
+
+constexpr SHA256::Hash Key::Compute(std::span<const uint8_t> message) const
+{
+    SHA256::Hasher hasher = InnerHasher();
+    hasher.Update(message.data(), message.size());
+    return Finalize(hasher);
+}
+
+constexpr SHA256::Hash Key::Compute(const SHA256::Hash& message) const
+{
+    return Detail::HashAfterBlock(outer, Detail::HashAfterBlock(inner, message));
+}
+
+constexpr SHA256::Hash Key::Finalize(SHA256::Hasher innerHasher) const
+{
+    return Detail::HashAfterBlock(outer, innerHasher.Finalize());
+}
+
+constexpr SHA256::Hash Compute(std::span<const uint8_t> key, std::span<const uint8_t> message)
+{
+    return Key(key).Compute(message);
+}
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+/*
+* Hash160 = RIPEMD160(SHA256(public key)), specialized for the two public key serializations:
+*  - Compressed:   0x02 or 0x03 (the parity of y), then x. 33 bytes, so SHA-256 needs one block.
+*  - Uncompressed: 0x04, then x, then y. 65 bytes, so SHA-256 needs two blocks.
+*
+* The SHA-256 message words are assembled directly from the 32-bit limbs of the coordinates, and the SHA-256
+* hash words are passed straight into a single RIPEMD-160 block whose padding is known in advance.
+* So there are no intermediate byte buffers and no generic padding logic.
+* Everything is templated on the word type, so the same code hashes N keys at once with Lanes<N>.
+*/
+
+#include "SHA256.h"
+#include "RIPEMD160.h"
+#include "Lanes.h"
+#include "Wide.h"
+
+namespace Hash160
+{
+    using Hash = RIPEMD160::Hash;
+    using Coordinate = UIntW<256>;
+
+    // Hash160 of the serialization of the public key (x, y)
+    Hash Compute(const Coordinate& x, const Coordinate& y, bool compressed);
+
+    // Hash160 of N public keys at once
+    template <size_t N>
+    std::array<Hash, N> ComputeLanes(const std::array<const Coordinate*, N>& x, const std::array<const Coordinate*, N>& y, bool compressed);
+
+    // Hash160 of an already serialized public key
+    Hash Compute(const std::array<uint8_t, 33>& compressedKey);
+    Hash Compute(const std::array<uint8_t, 65>& uncompressedKey);
+}
+
+
+/* Implementation follows */
+
+namespace Hash160
+{
+namespace Detail
+{
+    // Hash a serialized public key given its prefix byte and its coordinate words, most significant first.
+    // Each 32-bit SHA-256 message word straddles two coordinate words because of the prefix byte.
+    template <typename Word, size_t Count>
+    inline std::array<Word, 5> HashSerialization(const Word& prefix, const std::array<Word, Count>& Z)
+    {
+        static_assert(Count == 8 || Count == 16);
+        constexpr size_t BlockCount = Count / 16 + 1;
+        constexpr uint32_t MessageBits = (1 + Count * 4) * 8;
+
+        // SHA-256 of the 1 + 4 * Count bytes
+        std::array<Word, 16 * BlockCount> M;
+        M[0] = (prefix << 24) | (Z[0] >> 8);
+        for (size_t k = 1; k < Count; ++k)
+            M[k] = (Z[k - 1] << 24) | (Z[k] >> 8);
+        M[Count] = (Z[Count - 1] << 24) | Word(0x00800000); // The last byte, then the padding bit
+        for (size_t k = Count + 1; k < M.size() - 1; ++k)
+            M[k] = 0;
+        M.back() = MessageBits;
+
+        std::array<Word, 64> W;
+        std::array<Word, 8> H;
+        for (size_t i = 0; i < 8; ++i)
+            H[i] = SHA256::Detail::s_initialHash[i];
+        for (size_t block = 0; block < BlockCount; ++block)
+            SHA256::Detail::Process16WordBlock(&M[16 * block], W, H);
+
+        // RIPEMD-160 of the 32-byte digest: one block with fixed padding.
+        // RIPEMD-160 reads little-endian words, while SHA-256 produces big-endian words.
+        std::array<Word, 16> X;
+        for (size_t i = 0; i < 8; ++i)
+            X[i] = SHA256::Detail::ReverseEndianWord(H[i]);
+        X[8] = 0x00000080;
+        for (size_t i = 9; i < 16; ++i)
+            X[i] = 0;
+        X[14] = 32 * 8;
+
+        std::array<Word, 5> h;
+        const auto initial = RIPEMD160::Detail::initial();
+        for (size_t i = 0; i < 5; ++i)
+            h[i] = initial[i];
+        RIPEMD160::Detail::Process16WordBlock(&X[0], h);
+        return h;
+    }
+
+    // Coordinate words in serialization order: x then (for uncompressed keys) y, most significant word first
+    template <size_t Count>
+    inline std::array<uint32_t, Count> SerializationWords(const Coordinate& x, const Coordinate& y)
+    {
+        std::array<uint32_t, Count> Z;
+        for (size_t k = 0; k < 8; ++k)
+            Z[k] = x[7 - k];
+        for (size_t k = 8; k < Count; ++k)
+            Z[k] = y[15 - k];
+        return Z;
+    }
+
+    template <size_t Count>
+    inline Hash FromCoordinates(const Coordinate& x, const Coordinate& y)
+    {
+        const uint32_t prefix = Count == 16 ? 0x04 : y.IsOdd() ? 0x03 : 0x02;
+        return HashSerialization<uint32_t>(prefix, SerializationWords<Count>(x, y));
+    }
+
+    template <size_t N, size_t Count>
+    inline std::array<Hash, N> ComputeLanes(const std::array<const Coordinate*, N>& x, const std::array<const Coordinate*, N>& y)
+    {
+        Lanes<N> prefix;
+        std::array<Lanes<N>, Count> Z;
+        for (size_t lane = 0; lane < N; ++lane)
+        {
+            prefix.Set(lane, Count == 16 ? 0x04 : y[lane]->IsOdd() ? 0x03 : 0x02);
+            const auto words = SerializationWords<Count>(*x[lane], *y[lane]);
+            for (size_t k = 0; k < Count; ++k)
+                Z[k].Set(lane, words[k]);
+        }
+
+        const auto h = HashSerialization(prefix, Z);
+
+        std::array<Hash, N> rv;
+        for (size_t lane = 0; lane < N; ++lane)
+            for (size_t i = 0; i < 5; ++i)
+                rv[lane][i] = h[i][lane];
+        return rv;
+    }
+
+    template <size_t Size>
+    inline Hash FromBytes(const std::array<uint8_t, Size>& key)
+    {
+        constexpr size_t Count = (Size - 1) / 4;
+        std::array<uint32_t, Count> Z;
+        for (size_t k = 0; k < Count; ++k)
+            Z[k] = (uint32_t(key[1 + 4 * k]) << 24) | (uint32_t(key[2 + 4 * k]) << 16) | (uint32_t(key[3 + 4 * k]) << 8) | key[4 + 4 * k];
+        return HashSerialization<uint32_t>(key[0], Z);
+    }
+}
+
+inline Hash Compute(const Coordinate& x, const Coordinate& y, bool compressed)
+{
+    return compressed ? Detail::FromCoordinates<8>(x, y) : Detail::FromCoordinates<16>(x, y);
+}
+
+template <size_t N>
+inline std::array<Hash, N> ComputeLanes(const std::array<const Coordinate*, N>& x, const std::array<const Coordinate*, N>& y, bool compressed)
+{
+    return compressed ? Detail::ComputeLanes<N, 8>(x, y) : Detail::ComputeLanes<N, 16>(x, y);
+}
+
+inline Hash Compute(const std::array<uint8_t, 33>& compressedKey)
+{
+    return Detail::FromBytes(compressedKey);
+}
+
+inline Hash Compute(const std::array<uint8_t, 65>& uncompressedKey)
+{
+    return Detail::FromBytes(uncompressedKey);
+}
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+// Lanes<N> holds N independent words that are operated on in lock-step.
+// Every operator acts lane-wise, so code written once for a scalar word (e.g. a hash compression function)
+// can process N independent inputs at once, with each operator compiling down to one or two SIMD instructions.
+// GCC and Clang get there through their vector extensions. Elsewhere, plain per-lane loops are left to the auto-vectorizer.
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+template <size_t N, typename Base = uint32_t>
+class Lanes
+{
+public:
+    static_assert(N > 0 && (N & (N - 1)) == 0, "Lane count must be a power of two");
+    static constexpr size_t Count = N;
+
+#if defined(__GNUC__)
+    typedef Base Vector __attribute__((vector_size(N * sizeof(Base))));
+#else
+    // Stands in for the vector extension type, with the same lane-wise operators as plain loops
+    struct Vector
+    {
+        Base& operator[](size_t i) { return lanes[i]; }
+        const Base& operator[](size_t i) const { return lanes[i]; }
+
+        friend Vector operator +(const Vector& x, const Vector& y) { return Map(x, y, [](Base a, Base b) { return a + b; }); }
+        friend Vector operator -(const Vector& x, const Vector& y) { return Map(x, y, [](Base a, Base b) { return a - b; }); }
+        friend Vector operator *(const Vector& x, const Vector& y) { return Map(x, y, [](Base a, Base b) { return a * b; }); }
+        friend Vector operator ^(const Vector& x, const Vector& y) { return Map(x, y, [](Base a, Base b) { return a ^ b; }); }
+        friend Vector operator &(const Vector& x, const Vector& y) { return Map(x, y, [](Base a, Base b) { return a & b; }); }
+        friend Vector operator |(const Vector& x, const Vector& y) { return Map(x, y, [](Base a, Base b) { return a | b; }); }
+        friend Vector operator ~(const Vector& x) { return Map(x, x, [](Base a, Base) { return ~a; }); }
+        friend Vector operator <<(const Vector& x, size_t shift) { return Map(x, x, [shift](Base a, Base) { return a << shift; }); }
+        friend Vector operator >>(const Vector& x, size_t shift) { return Map(x, x, [shift](Base a, Base) { return a >> shift; }); }
+
+        template <typename Op>
+        static Vector Map(const Vector& x, const Vector& y, Op op)
+        {
+            Vector rv;
+            for (size_t i = 0; i < N; ++i)
+                rv.lanes[i] = static_cast<Base>(op(x.lanes[i], y.lanes[i]));
+            return rv;
+        }
+
+        std::array<Base, N> lanes;
+    };
+#endif
+
+    Lanes() : v{} {}
+    Lanes(Base x) // Broadcast the same value to every lane
+    {
+        for (size_t i = 0; i < N; ++i)
+            v[i] = x;
+    }
+
+    Base operator[](size_t i) const { return v[i]; }
+    void Set(size_t i, Base x) { v[i] = x; }
+
+    // Load or store N consecutive words, e.g. one row of a structure-of-arrays batch
+    static Lanes Load(const Base* p)
+    {
+        Lanes rv;
+        std::memcpy(&rv.v, p, sizeof(rv.v));
+        return rv;
+    }
+    void Store(Base* p) const { std::memcpy(p, &v, sizeof(v)); }
+
+    friend Lanes operator +(const Lanes& lhs, const Lanes& rhs) { return FromVector(lhs.v + rhs.v); }
+    friend Lanes operator -(const Lanes& lhs, const Lanes& rhs) { return FromVector(lhs.v - rhs.v); }
+    friend Lanes operator *(const Lanes& lhs, const Lanes& rhs) { return FromVector(lhs.v * rhs.v); }
+    friend Lanes operator ^(const Lanes& lhs, const Lanes& rhs) { return FromVector(lhs.v ^ rhs.v); }
+    friend Lanes operator &(const Lanes& lhs, const Lanes& rhs) { return FromVector(lhs.v & rhs.v); }
+    friend Lanes operator |(const Lanes& lhs, const Lanes& rhs) { return FromVector(lhs.v | rhs.v); }
+    friend Lanes operator ~(const Lanes& rhs) { return FromVector(~rhs.v); }
+
+    friend Lanes operator <<(const Lanes& lhs, size_t shift) { return FromVector(lhs.v << shift); }
+    friend Lanes operator >>(const Lanes& lhs, size_t shift) { return FromVector(lhs.v >> shift); }
+
+    Lanes& operator +=(const Lanes& rhs) { return *this = *this + rhs; }
+    Lanes& operator ^=(const Lanes& rhs) { return *this = *this ^ rhs; }
+
+private:
+    // Vector values only ever pass between functions by reference. Passed or returned by value, their ABI would depend
+    // on the instruction set the caller was compiled for (GCC warns of this with -Wpsabi).
+    static Lanes FromVector(const Vector& v)
+    {
+        Lanes rv;
+        rv.v = v;
+        return rv;
+    }
+
+    Vector v;
+};
@@ -0,0 +1,252 @@
+#pragma once
+
+/*
+* Block header nonce scanning.
+*
+* A block header is 80 bytes, so its double SHA-256 hash takes three compressions: two for the first hash
+* (the header plus padding spans two 512-bit blocks), and one for the second hash of the 32-byte digest.
+* Only the nonce changes from one attempt to the next, and it sits in the second block of the header. So:
+*  - The hash state after the first 64 bytes (the midstate) is computed once.
+*  - The first three rounds of the second block, and the first two extended schedule words, don't depend on the nonce.
+*  - The most significant word of the final hash is known after 61 of the 64 rounds of the last compression,
+*    which is enough to reject almost all nonces before finishing the hash.
+* Nonces are processed in lanes (see Lanes.h) and distributed over threads.
+*/
+
+#include "Bitcoin.h"
+#include "Lanes.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace Mining
+{
+    using Header = ByteArray<80>;
+    using Target = UIntW<256>;
+
+    struct ScanResult
+    {
+        bool found = false;
+        uint32_t nonce = 0;
+        Bitcoin::LongHash hash = std::array<uint8_t, 32>{}; // As returned by Bitcoin::DoubleHashLong
+        uint64_t hashCount = 0;
+        double seconds = 0;
+
+        double HashesPerSecond() const
+        {
+            return seconds > 0 ? hashCount / seconds : 0;
+        }
+    };
+
+    // Expand the compact "nBits" encoding of the target into a 256-bit integer
+    Target CompactToTarget(uint32_t bits);
+
+    // Interpret a double SHA-256 hash as a little-endian 256-bit integer and test it against the target
+    bool HashMeetsTarget(const Bitcoin::LongHash& hash, const Target& target);
+
+    // Set the nonce field (the last four bytes of the header, little-endian)
+    void SetNonce(Header& header, uint32_t nonce);
+
+    // Search the nonces [firstNonce, firstNonce + nonceCount) and return the first one whose hash is at or below the target.
+    // threadCount = 0 uses all hardware threads.
+    ScanResult Scan(const Header& header, const Target& target, uint32_t firstNonce = 0, uint64_t nonceCount = 1ull << 32, unsigned threadCount = 0);
+}
+
+
+/* Implementation follows */
+
+namespace Mining
+{
+namespace Detail
+{
+    constexpr size_t LaneCount = 8;
+    constexpr uint64_t NoncesPerChunk = 1 << 16;
+
+    template <size_t N> inline uint32_t LoadBigEndianWord(const ByteArray<N>& bytes, size_t offset)
+    {
+        return (uint32_t(bytes[offset]) << 24) | (uint32_t(bytes[offset + 1]) << 16) | (uint32_t(bytes[offset + 2]) << 8) | bytes[offset + 3];
+    }
+
+    // Everything about the hash of a header that doesn't depend on the nonce
+    struct Precomputed
+    {
+        SHA256::Hash midstate;             // Hash value after the first 64 bytes of the header
+        SHA256::Hash roundState;           // Working variables a-h after the first three rounds of the second block
+        std::array<uint32_t, 64> schedule; // Message schedule of the second block. Only entries 0-17, except 3, are valid.
+    };
+
+    inline Precomputed Precompute(const Header& header)
+    {
+        using namespace SHA256::Detail;
+
+        Precomputed pre;
+        std::array<uint32_t, 16> M;
+        Schedule W;
+
+        for (size_t i = 0; i < 16; ++i)
+            M[i] = LoadBigEndianWord(header, 4 * i);
+        pre.midstate = s_initialHash;
+        Process16WordBlock(&M[0], W, pre.midstate);
+
+        // Second block: the last 16 bytes of the header (the nonce is word 3), then padding and the message length
+        auto& S = pre.schedule;
+        S = {};
+        for (size_t i = 0; i < 3; ++i)
+            S[i] = LoadBigEndianWord(header, 64 + 4 * i);
+        S[4] = 0x80000000;
+        S[15] = 80 * 8;
+        S[16] = sigma_1(S[14]) + S[9] + sigma_0(S[1]) + S[0];
+        S[17] = sigma_1(S[15]) + S[10] + sigma_0(S[2]) + S[1];
+
+        pre.roundState = pre.midstate;
+        ProcessRounds(pre.roundState, S, 0, 3);
+        return pre;
+    }
+
+    // Hash Lanes nonces starting at firstNonce, returning for each lane the most significant word
+    // of the hash when interpreted as a little-endian 256-bit integer
+    template <size_t N>
+    inline Lanes<N> HashTopWords(const Precomputed& pre, uint32_t firstNonce)
+    {
+        using namespace SHA256::Detail;
+        using Word = Lanes<N>;
+
+        // Finish the first hash
+        std::array<Word, 64> W;
+        for (size_t t = 0; t < 18; ++t)
+            W[t] = pre.schedule[t];
+        for (size_t i = 0; i < N; ++i)
+            W[3].Set(i, ReverseEndianWord(firstNonce + static_cast<uint32_t>(i)));
+        ExpandSchedule(W, 18);
+
+        std::array<Word, 8> v;
+        for (size_t i = 0; i < 8; ++i)
+            v[i] = pre.roundState[i];
+        ProcessRounds(v, W, 3, 64);
+
+        // The second hash is of the 32-byte digest: one block
+        for (size_t i = 0; i < 8; ++i)
+            W[i] = v[i] + pre.midstate[i];
+        W[8] = 0x80000000;
+        for (size_t i = 9; i < 15; ++i)
+            W[i] = 0;
+        W[15] = 32 * 8;
+        ExpandSchedule(W);
+
+        for (size_t i = 0; i < 8; ++i)
+            v[i] = s_initialHash[i];
+
+        // After round 60, e holds what will be h after round 63, so H[7] is known
+        ProcessRounds(v, W, 0, 61);
+        const Word H7 = v[4] + s_initialHash[7];
+
+        Word rv;
+        for (size_t i = 0; i < N; ++i)
+            rv.Set(i, ReverseEndianWord(H7[i]));
+        return rv;
+    }
+
+    inline bool TryNonce(Header& header, uint32_t nonce, const Target& target)
+    {
+        SetNonce(header, nonce);
+        return HashMeetsTarget(Bitcoin::DoubleHashLong(header.begin(), header.end()), target);
+    }
+}
+
+inline Target CompactToTarget(uint32_t bits)
+{
+    Target target;
+    const int exponent = bits >> 24;
+    uint32_t mantissa = bits & 0x007FFFFF;
+    if (bits & 0x00800000) // Negative targets can't be met
+        return target;
+    for (int i = 0; i < 3; ++i, mantissa >>= 8)
+    {
+        const int byteIndex = exponent - 3 + i;
+        if (byteIndex >= 0 && byteIndex < 32)
+            target.SetByte(byteIndex, static_cast<uint8_t>(mantissa));
+    }
+    return target;
+}
+
+inline bool HashMeetsTarget(const Bitcoin::LongHash& hash, const Target& target)
+{
+    Target value;
+    for (size_t i = 0; i < 32; ++i)
+        value.SetByte(i, hash[i]);
+    return value <= target;
+}
+
+inline void SetNonce(Header& header, uint32_t nonce)
+{
+    for (size_t i = 0; i < 4; ++i)
+        header[76 + i] = static_cast<uint8_t>(nonce >> (8 * i));
+}
+
+inline ScanResult Scan(const Header& header, const Target& target, uint32_t firstNonce, uint64_t nonceCount, unsigned threadCount)
+{
+    using namespace Detail;
+
+    const auto start = std::chrono::steady_clock::now();
+    const Precomputed pre = Precompute(header);
+    const uint32_t targetTopWord = target[7];
+
+    std::atomic<uint64_t> nextChunk = 0, hashCount = 0;
+    std::atomic<uint64_t> bestOffset = nonceCount; // Offset from firstNonce of the lowest successful nonce so far
+
+    auto worker = [&]()
+    {
+        Header local = header;
+        uint64_t hashes = 0;
+        while (true)
+        {
+            const uint64_t chunkBegin = nextChunk.fetch_add(NoncesPerChunk);
+            if (chunkBegin >= std::min(nonceCount, bestOffset.load()))
+                break;
+            const uint64_t chunkEnd = std::min(chunkBegin + NoncesPerChunk, nonceCount);
+            for (uint64_t offset = chunkBegin; offset < chunkEnd; offset += LaneCount)
+            {
+                const auto topWords = HashTopWords<LaneCount>(pre, static_cast<uint32_t>(firstNonce + offset));
+                hashes += std::min<uint64_t>(LaneCount, chunkEnd - offset); // The last group may be partial
+                for (size_t lane = 0; lane < LaneCount && offset + lane < chunkEnd; ++lane)
+                {
+                    if (topWords[lane] > targetTopWord)
+                        continue;
+                    // Rare: confirm the candidate with the full hash
+                    if (!TryNonce(local, static_cast<uint32_t>(firstNonce + offset + lane), target))
+                        continue;
+                    uint64_t best = bestOffset.load();
+                    while (offset + lane < best && !bestOffset.compare_exchange_weak(best, offset + lane));
+                    offset = chunkEnd; // No need to look at later nonces in this chunk
+                    break;
+                }
+            }
+        }
+        hashCount += hashes;
+    };
+
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < threadCount; ++i)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& thread : threads)
+        thread.join();
+
+    ScanResult result;
+    result.hashCount = hashCount;
+    if (bestOffset < nonceCount)
+    {
+        Header winner = header;
+        result.found = true;
+        result.nonce = static_cast<uint32_t>(firstNonce + bestOffset);
+        SetNonce(winner, result.nonce);
+        result.hash = Bitcoin::DoubleHashLong(winner.begin(), winner.end());
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+}
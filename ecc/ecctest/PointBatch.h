@@ -0,0 +1,181 @@
+#pragma once
+
+/*
+* Structure-of-arrays storage for many field elements or curve points.
+*
+* FpBatch keeps limb k of every element in one contiguous row, aligned to Alignment bytes and padded to a multiple
+* of PaddedCount elements, so a loop over one limb of the whole batch reads consecutive words with no gathers or tails.
+* Rows can be read and written as Lanes<N> (see Lanes.h) to process N elements per instruction.
+* PointBatch is a pair of FpBatch for the x and y coordinates.
+*/
+
+#include "Lanes.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <stdexcept>
+
+template <typename Field>
+class FpBatch
+{
+public:
+    using Base = typename Field::Base;
+    using Type = typename Field::Type;
+    static constexpr size_t LimbCount = Type::ElementCount;
+    static constexpr size_t Alignment = 64; // A cache line, and the widest SIMD register
+    static constexpr size_t PaddedCount = Alignment / sizeof(Base);
+
+    FpBatch() = default;
+    explicit FpBatch(size_t count);
+    explicit FpBatch(std::span<const Field> elements);
+
+    size_t size() const { return count; }
+
+    // Limb k of every element (the least significant limb first), padded with zeros to a multiple of PaddedCount
+    std::span<Base> Limbs(size_t k) { return { &limbs[k * stride], stride }; }
+    std::span<const Base> Limbs(size_t k) const { return { &limbs[k * stride], stride }; }
+
+    Field Get(size_t index) const;
+    void Set(size_t index, const Field& element);
+
+    // Limb k of the N elements starting at index, which must be a multiple of N
+    template <size_t N> Lanes<N, Base> GetLanes(size_t k, size_t index) const;
+    template <size_t N> void SetLanes(size_t k, size_t index, const Lanes<N, Base>& lanes);
+
+    void Load(std::span<const Field> elements);
+    void Store(std::span<Field> elements) const;
+
+private:
+    struct AlignedDelete
+    {
+        void operator ()(Base* p) const { ::operator delete[](p, std::align_val_t(Alignment)); }
+    };
+
+    size_t count = 0;
+    size_t stride = 0; // Elements per row, including padding
+    std::unique_ptr<Base[], AlignedDelete> limbs;
+};
+
+template <typename Curve>
+class PointBatch
+{
+public:
+    using Point = typename Curve::Point;
+    using Field = typename Curve::Mod_p;
+
+    PointBatch() = default;
+    explicit PointBatch(size_t count) : x(count), y(count) {}
+    explicit PointBatch(std::span<const Point> points);
+
+    size_t size() const { return x.size(); }
+
+    Point Get(size_t index) const { return { x.Get(index), y.Get(index) }; }
+    void Set(size_t index, const Point& point);
+
+    void Load(std::span<const Point> points);
+    void Store(std::span<Point> points) const;
+
+    FpBatch<Field> x, y;
+};
+
+
+/* Implementation follows */
+
+template <typename Field>
+FpBatch<Field>::FpBatch(size_t count)
+    : count(count), stride((count + PaddedCount - 1) / PaddedCount * PaddedCount),
+      limbs(static_cast<Base*>(::operator new[](std::max<size_t>(1, LimbCount * stride) * sizeof(Base), std::align_val_t(Alignment))))
+{
+    std::fill(limbs.get(), limbs.get() + LimbCount * stride, Base(0));
+}
+
+template <typename Field>
+FpBatch<Field>::FpBatch(std::span<const Field> elements) : FpBatch(elements.size())
+{
+    Load(elements);
+}
+
+template <typename Field>
+Field FpBatch<Field>::Get(size_t index) const
+{
+    Type x;
+    for (size_t k = 0; k < LimbCount; ++k)
+        x.m_a[k] = limbs[k * stride + index];
+    return Field(x);
+}
+
+template <typename Field>
+void FpBatch<Field>::Set(size_t index, const Field& element)
+{
+    const Type x = element.Value();
+    for (size_t k = 0; k < LimbCount; ++k)
+        limbs[k * stride + index] = x.m_a[k];
+}
+
+template <typename Field>
+template <size_t N>
+Lanes<N, typename Field::Base> FpBatch<Field>::GetLanes(size_t k, size_t index) const
+{
+    static_assert(PaddedCount % N == 0);
+    return Lanes<N, Base>::Load(&limbs[k * stride + index]);
+}
+
+template <typename Field>
+template <size_t N>
+void FpBatch<Field>::SetLanes(size_t k, size_t index, const Lanes<N, Base>& lanes)
+{
+    static_assert(PaddedCount % N == 0);
+    lanes.Store(&limbs[k * stride + index]);
+}
+
+template <typename Field>
+void FpBatch<Field>::Load(std::span<const Field> elements)
+{
+    if (elements.size() != count)
+        throw std::invalid_argument("Batch size mismatch");
+    for (size_t i = 0; i < count; ++i)
+        Set(i, elements[i]);
+}
+
+template <typename Field>
+void FpBatch<Field>::Store(std::span<Field> elements) const
+{
+    if (elements.size() != count)
+        throw std::invalid_argument("Batch size mismatch");
+    for (size_t i = 0; i < count; ++i)
+        elements[i] = Get(i);
+}
+
+template <typename Curve>
+PointBatch<Curve>::PointBatch(std::span<const Point> points) : PointBatch(points.size())
+{
+    Load(points);
+}
+
+template <typename Curve>
+void PointBatch<Curve>::Set(size_t index, const Point& point)
+{
+    x.Set(index, point.x);
+    y.Set(index, point.y);
+}
+
+template <typename Curve>
+void PointBatch<Curve>::Load(std::span<const Point> points)
+{
+    if (points.size() != size())
+        throw std::invalid_argument("Batch size mismatch");
+    for (size_t i = 0; i < points.size(); ++i)
+        Set(i, points[i]);
+}
+
+template <typename Curve>
+void PointBatch<Curve>::Store(std::span<Point> points) const
+{
+    if (points.size() != size())
+        throw std::invalid_argument("Batch size mismatch");
+    for (size_t i = 0; i < points.size(); ++i)
+        points[i] = Get(i);
+}
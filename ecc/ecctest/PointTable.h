@@ -0,0 +1,230 @@
+#pragma once
+
+/*
+* Precomputed multiples of a fixed point, for fast scalar multiplication by that point.
+*
+* A PointTable splits the scalar into 4-bit windows and stores j 2^(4w) P for every window w and digit j = 1..15.
+* A multiplication is then one table lookup and one addition per window, with no doublings at all: 64 additions
+* for 256 bits, against about 256 doublings and 128 additions for double-and-add. The sum is accumulated in
+* Jacobian coordinates, so the only inversion is the one that makes the result affine.
+* Building a table costs 960 additions and 64 inversions, so it pays off after a few uses of the same point.
+*
+* EllipticCurve keeps one for the generator G. For public keys that sign often, a PointTableCache keeps the tables
+* of the most recently used keys, up to a fixed number, and can be shared by any number of verifying threads.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+template <typename Curve>
+class PointTable
+{
+public:
+    using Point = typename Curve::Point;
+    using JacobianPoint = typename Curve::JacobianPoint;
+    using Wide = typename Curve::Wide;
+
+    static constexpr size_t WindowBits = 4;
+    static constexpr size_t WindowCount = Wide::BitCount / WindowBits;
+    static constexpr size_t DigitCount = (size_t(1) << WindowBits) - 1; // Non-zero digits per window
+
+    explicit PointTable(const Point& base);
+
+    const Point& Base() const { return base; }
+
+    // scalar * Base(), for any scalar (not necessarily reduced mod n)
+    Point Multiply(const Wide& scalar) const;
+
+    // The same in Jacobian form, e.g. to make many results affine together with Curve::ToAffine.
+    // The multiples are added to sum, so another product already in Jacobian form shares the final inversion.
+    JacobianPoint MultiplyJacobian(const Wide& scalar, JacobianPoint sum = {}) const;
+
+    // Memory held by the table
+    size_t ByteCount() const { return sizeof(*this) + points.capacity() * sizeof(Point); }
+
+private:
+    static_assert(sizeof(typename Wide::Base) * 8 % WindowBits == 0);
+
+    Point base;
+    std::vector<Point> points; // j 2^(4w) base at index w * DigitCount + j - 1
+};
+
+// A bounded cache of PointTables keyed by public key. Lookups of cached keys only take a shared lock,
+// so concurrent verifiers do not serialize on hits. When full, the least recently used table is evicted.
+template <typename Curve>
+class PointTableCache
+{
+public:
+    using Point = typename Curve::Point;
+    using Table = PointTable<Curve>;
+
+    struct Statistics
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t entryCount = 0;
+        size_t byteCount = 0;
+
+        double HitRate() const
+        {
+            return hits + misses > 0 ? double(hits) / (hits + misses) : 0;
+        }
+    };
+
+    explicit PointTableCache(size_t capacity);
+
+    // The table for publicKey, built on a miss. Throws std::invalid_argument if the key is not a valid public key,
+    // so a table from the cache never needs validating again. The table stays valid while the pointer is held, even if evicted.
+    std::shared_ptr<const Table> Get(const Point& publicKey);
+
+    Statistics GetStatistics() const;
+    size_t Capacity() const { return capacity; }
+    void Clear();
+
+private:
+    using Key = decltype(std::declval<Point>().Compressed());
+
+    struct KeyHash
+    {
+        size_t operator ()(const Key& key) const
+        {
+            size_t hash; // The bytes of x are already uniformly distributed
+            std::memcpy(&hash, key.data() + 1, sizeof(hash));
+            return hash ^ key[0];
+        }
+    };
+
+    struct Entry
+    {
+        std::shared_ptr<const Table> table;
+        std::atomic<uint64_t> lastUse = 0;
+    };
+
+    void EvictLeastRecentlyUsed(); // With the lock held exclusively
+
+    const size_t capacity;
+    mutable std::shared_mutex mutex;
+    std::unordered_map<Key, Entry, KeyHash> entries;
+    std::atomic<uint64_t> clock = 0, hits = 0, misses = 0, evictions = 0;
+};
+
+
+/* Implementation follows */
+
+template <typename Curve>
+PointTable<Curve>::PointTable(const Point& base) : base(base), points(WindowCount * DigitCount)
+{
+    // Each row is summed in Jacobian form and made affine with one inversion, together with the next power
+    std::vector<JacobianPoint> row(DigitCount + 1);
+    std::vector<Point> affine(DigitCount + 1);
+    Point power = base; // 2^(4w) base
+    for (size_t w = 0; w < WindowCount; ++w)
+    {
+        row[0] = power;
+        for (size_t j = 1; j <= DigitCount; ++j)
+            row[j] = row[j - 1] + power;
+        Curve::ToAffine(row, affine);
+        std::copy(affine.begin(), affine.begin() + DigitCount, points.begin() + w * DigitCount);
+        power = affine[DigitCount];
+    }
+}
+
+template <typename Curve>
+typename PointTable<Curve>::Point PointTable<Curve>::Multiply(const Wide& scalar) const
+{
+    return MultiplyJacobian(scalar).ToAffine();
+}
+
+template <typename Curve>
+typename PointTable<Curve>::JacobianPoint PointTable<Curve>::MultiplyJacobian(const Wide& scalar, JacobianPoint sum) const
+{
+    constexpr size_t WindowsPerWord = sizeof(typename Wide::Base) * 8 / WindowBits;
+    for (size_t w = 0; w < WindowCount; ++w)
+    {
+        const size_t digit = (scalar.m_a[w / WindowsPerWord] >> (w % WindowsPerWord * WindowBits)) & DigitCount;
+        if (digit != 0)
+            sum += points[w * DigitCount + digit - 1];
+    }
+    return sum;
+}
+
+template <typename Curve>
+PointTableCache<Curve>::PointTableCache(size_t capacity) : capacity(capacity)
+{
+    if (capacity == 0)
+        throw std::invalid_argument("Cache capacity must be positive");
+}
+
+template <typename Curve>
+std::shared_ptr<const PointTable<Curve>> PointTableCache<Curve>::Get(const Point& publicKey)
+{
+    const Key key = publicKey.Compressed();
+    {
+        std::shared_lock lock(mutex);
+        const auto it = entries.find(key);
+        if (it != entries.end())
+        {
+            it->second.lastUse = ++clock;
+            ++hits;
+            return it->second.table;
+        }
+    }
+
+    // Build outside the lock, so that hits on other keys carry on meanwhile
+    ++misses;
+    if (!Curve::IsPublicKeyValid(publicKey))
+        throw std::invalid_argument("Invalid public key");
+    auto table = std::make_shared<const Table>(publicKey);
+
+    std::unique_lock lock(mutex);
+    const auto [it, inserted] = entries.try_emplace(key);
+    it->second.lastUse = ++clock;
+    if (inserted) // Otherwise another thread built the same table first: keep theirs
+    {
+        it->second.table = std::move(table);
+        if (entries.size() > capacity)
+            EvictLeastRecentlyUsed();
+    }
+    return it->second.table;
+}
+
+template <typename Curve>
+void PointTableCache<Curve>::EvictLeastRecentlyUsed()
+{
+    auto oldest = entries.begin();
+    for (auto it = entries.begin(); it != entries.end(); ++it)
+        if (it->second.lastUse < oldest->second.lastUse)
+            oldest = it;
+    entries.erase(oldest);
+    ++evictions;
+}
+
+template <typename Curve>
+typename PointTableCache<Curve>::Statistics PointTableCache<Curve>::GetStatistics() const
+{
+    std::shared_lock lock(mutex);
+    Statistics statistics;
+    statistics.hits = hits;
+    statistics.misses = misses;
+    statistics.evictions = evictions;
+    statistics.entryCount = entries.size();
+    for (const auto& [key, entry] : entries)
+        statistics.byteCount += entry.table->ByteCount();
+    return statistics;
+}
+
+template <typename Curve>
+void PointTableCache<Curve>::Clear()
+{
+    std::unique_lock lock(mutex);
+    entries.clear();
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+/*
+* Deterministic signature nonces, as specified in RFC 6979 with HMAC-SHA256, for curves with a 256-bit order such as secp256k1.
+*
+* Nonces is a nonce policy: pass it to EllipticCurve::SignMessage (or Bitcoin::Sign etc.) in place of the random generator.
+* Each nonce is then derived from the private key and the message hash, so signing the same message with the same key
+* always gives the same signature, and needs no randomness at all.
+*
+* The derivation is a chain of HMACs whose keys change as it goes. Every HMAC key gets its padded-key midstates once,
+* and the first HMAC, whose key is fixed and whose message starts with the private key, resumes from a hasher state
+* kept in the Nonces object. So sign with one Nonces per private key, rather than constructing one per signature.
+*/
+
+#include "HMAC.h"
+#include "Wide.h"
+
+#include <stdexcept>
+
+namespace RFC6979
+{
+    class Nonces
+    {
+    public:
+        using Wide = UIntW<256>;
+
+        explicit Nonces(const Wide& privateKey);
+
+        // The candidate nonces for signing a hash, in the order of RFC 6979 section 3.2. Each is the raw bits2int(V),
+        // not reduced modulo the curve order, so it may be 0 or at least n. The signer must reject any candidate outside
+        // [1, n) and draw the next, never reduce it, which would bias the nonces and break conformance with the RFC.
+        // It takes the first that lies in [1, n) and gives non-zero r and s.
+        class Candidates
+        {
+        public:
+            Wide operator ()();
+
+        private:
+            friend class Nonces;
+            Candidates(const HMAC::Key& K, const SHA256::Hash& V) : K(K), V(V) {}
+
+            HMAC::Key K;
+            SHA256::Hash V;
+            bool first = true;
+        };
+
+        // Throws std::invalid_argument for a different private key than this was constructed with
+        Candidates Start(const Wide& privateKey, const Wide& hash) const;
+
+    private:
+        Wide privateKey;
+        SHA256::Hasher keyedHasher; // The inner hasher of HMAC_K(V || 0x00 || x || h) for the initial K and V, up to the end of x
+    };
+}
+
+
+/* Implementation follows */
+
+namespace RFC6979
+{
+namespace Detail
+{
+    // The initial K = 0x00 0x00 ... 0x00 and V = 0x01 0x01 ... 0x01
+    inline const HMAC::Key& InitialKey()
+    {
+        static const HMAC::Key key(SHA256::Hash{});
+        return key;
+    }
+
+    constexpr SHA256::Hash s_initialV = { 0x01010101, 0x01010101, 0x01010101, 0x01010101, 0x01010101, 0x01010101, 0x01010101, 0x01010101 };
+
+    inline std::array<uint8_t, 32> ToBytes(const UIntW<256>& x)
+    {
+        std::array<uint8_t, 32> bytes;
+        x.ToBigEndianBytes(bytes.data(), bytes.size());
+        return bytes;
+    }
+
+    inline std::array<uint8_t, 32> ToBytes(const SHA256::Hash& words)
+    {
+        std::array<uint8_t, 32> bytes;
+        for (size_t i = 0; i < bytes.size(); ++i)
+            bytes[i] = static_cast<uint8_t>(words[i / 4] >> (24 - 8 * (i % 4)));
+        return bytes;
+    }
+
+    // HMAC_K(V || separator), the key update when a candidate is rejected
+    inline HMAC::Key NextKey(const HMAC::Key& K, const SHA256::Hash& V, uint8_t separator)
+    {
+        auto hasher = K.InnerHasher();
+        const auto bytes = ToBytes(V);
+        hasher.Update(bytes.data(), bytes.size());
+        hasher.Update(&separator, 1);
+        return HMAC::Key(K.Finalize(hasher));
+    }
+}
+
+inline Nonces::Nonces(const Wide& privateKey) : privateKey(privateKey), keyedHasher(Detail::InitialKey().InnerHasher())
+{
+    const auto V = Detail::ToBytes(Detail::s_initialV);
+    const auto x = Detail::ToBytes(privateKey);
+    const uint8_t separator = 0x00;
+    keyedHasher.Update(V.data(), V.size());
+    keyedHasher.Update(&separator, 1);
+    keyedHasher.Update(x.data(), x.size());
+}
+
+inline Nonces::Candidates Nonces::Start(const Wide& privateKey, const Wide& hash) const
+{
+    if (privateKey != this->privateKey)
+        throw std::invalid_argument("Nonces were constructed for a different private key");
+
+    // Steps d to g: K = HMAC_K(V || 0x00 || x || h), V = HMAC_K(V), K = HMAC_K(V || 0x01 || x || h), V = HMAC_K(V)
+    const auto x = Detail::ToBytes(privateKey);
+    const auto h = Detail::ToBytes(hash);
+    auto hasher = keyedHasher;
+    hasher.Update(h.data(), h.size());
+    HMAC::Key K(Detail::InitialKey().Finalize(hasher));
+    SHA256::Hash V = K.Compute(Detail::s_initialV);
+
+    hasher = K.InnerHasher();
+    const auto vBytes = Detail::ToBytes(V);
+    const uint8_t separator = 0x01;
+    hasher.Update(vBytes.data(), vBytes.size());
+    hasher.Update(&separator, 1);
+    hasher.Update(x.data(), x.size());
+    hasher.Update(h.data(), h.size());
+    K = HMAC::Key(K.Finalize(hasher));
+    V = K.Compute(V);
+    return Candidates(K, V);
+}
+
+inline Nonces::Wide Nonces::Candidates::operator ()()
+{
+    // Step h: after a rejected candidate, K = HMAC_K(V || 0x00) and V = HMAC_K(V), then the next is HMAC_K(V)
+    if (!first)
+    {
+        K = Detail::NextKey(K, V, 0x00);
+        V = K.Compute(V);
+    }
+    first = false;
+    V = K.Compute(V);
+
+    Wide k; // The words of V are big-endian, most significant first
+    for (size_t i = 0; i < V.size(); ++i)
+        k.m_a[i] = V[V.size() - 1 - i];
+    return k;
+}
+}
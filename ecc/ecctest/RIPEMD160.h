@@ -5,6 +5,10 @@
 // 
 
 #include <array>
+#include <algorithm>
+#include <initializer_list>
+#include <span>
+#include <utility>
 
 namespace RIPEMD160
 {
@@ -14,6 +18,14 @@ namespace RIPEMD160
 
     template <typename Iter> Hash Compute(Iter begin, Iter end);
 
+    // The hash of the concatenation of the pieces, without copying them into one buffer first
+    Hash Compute(std::span<const std::span<const unsigned char>> pieces);
+    Hash Compute(std::initializer_list<std::span<const unsigned char>> pieces);
+
+    // Incremental hashing: Update with the message in pieces of any size, then Finalize.
+    // The result is the same as Compute over the concatenation of the pieces.
+    class Hasher;
+
     namespace Detail
     {
         static constexpr std::array<uint8_t, 80> r = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
@@ -45,99 +57,141 @@ namespace RIPEMD160
             return (x << 24) | ((x & 0x0000FF00) << 8) | ((x & 0x00FF0000) >> 8) | (x >> 24);
         }
 
-        inline uint32_t K(uint8_t j)
-        {
-            static constexpr std::array<uint32_t, 5> Karr = { 0x00000000, 0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xA953FD4E };
-            return Karr[j >> 4];
-        }
-
-        inline uint32_t Kp(uint8_t j)
-        {
-            static constexpr std::array<uint32_t, 5> Kparr = { 0x50A28BE6, 0x5C4DD124, 0x6D703EF3, 0x7A6D76E9, 0x00000000 };
-            return Kparr[j >> 4];
-        }
+        static constexpr std::array<uint32_t, 5> K = { 0x00000000, 0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xA953FD4E };
+        static constexpr std::array<uint32_t, 5> Kp = { 0x50A28BE6, 0x5C4DD124, 0x6D703EF3, 0x7A6D76E9, 0x00000000 };
 
         inline constexpr Hash initial()
         {
             return { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
         }
 
-        inline uint32_t rol(uint32_t x, uint8_t bits)
+        template <uint8_t Bits, typename Word> inline Word rol(const Word& x)
         {
-            return (x << bits) | (x >> (32 - bits));
+            return (x << Bits) | (x >> (32 - Bits));
         }
 
-        inline uint32_t f(uint8_t j, uint32_t x, uint32_t y, uint32_t z)
+        // The boolean function for step j, chosen at compile time
+        template <uint8_t j, typename Word> inline Word f(const Word& x, const Word& y, const Word& z)
         {
-            if (j < 16)
+            if constexpr (j < 16)
                 return x ^ y ^ z;
-            else if (j < 32)
+            else if constexpr (j < 32)
                 return (x & y) | (~x & z);
-            else if (j < 48)
+            else if constexpr (j < 48)
                 return (x | ~y) ^ z;
-            else if (j < 64)
+            else if constexpr (j < 64)
                 return (x & z) | (y & ~z);
             else
                 return x ^ (y | ~z);
         }
 
-        inline void Process16WordBlock(const uint32_t* X_i, Hash& h)
+        // Step j of both lines, which are independent so their instructions can overlap.
+        // Rather than shuffling A-E along after each step, the variables stay put in the slots of v (and vp)
+        // while the slot that plays the role of A moves back by one each step. Once the steps are unrolled,
+        // every slot, message index, rotation, constant and boolean function is known at compile time.
+        template <uint8_t j, typename Word>
+        inline void Step(const Word* X, std::array<Word, 5>& v, std::array<Word, 5>& vp)
         {
-            auto A = h[0], B = h[1], C = h[2], D = h[3], E = h[4];
-            auto Ap = A, Bp = B, Cp = C, Dp = D, Ep = E;
-            uint32_t T;
-            for (auto j = 0; j < 80; ++j)
+            constexpr uint8_t A = (5 - j % 5) % 5, B = (A + 1) % 5, C = (A + 2) % 5, D = (A + 3) % 5, E = (A + 4) % 5;
+            v[A] = rol<s[j]>(v[A] + f<j>(v[B], v[C], v[D]) + X[r[j]] + K[j >> 4]) + v[E];
+            v[C] = rol<10>(v[C]);
+            vp[A] = rol<sp[j]>(vp[A] + f<79 - j>(vp[B], vp[C], vp[D]) + X[rp[j]] + Kp[j >> 4]) + vp[E];
+            vp[C] = rol<10>(vp[C]);
+        }
+
+        template <typename Word, uint8_t... j>
+        inline void Steps(const Word* X, std::array<Word, 5>& v, std::array<Word, 5>& vp, std::integer_sequence<uint8_t, j...>)
+        {
+            (Step<j>(X, v, vp), ...);
+        }
+
+        // Templated on the word type so that it applies both to uint32_t and to Lanes<N, uint32_t>
+        template <typename Word>
+        inline void Process16WordBlock(const Word* X_i, std::array<Word, 5>& h)
+        {
+            std::array<Word, 5> v = h, vp = h;
+            Steps(X_i, v, vp, std::make_integer_sequence<uint8_t, 80>());
+
+            // After 80 steps the roles have come back round, so v = { A, B, C, D, E }
+            const Word T = h[1] + v[2] + vp[3];
+            h[1] = h[2] + v[3] + vp[4]; h[2] = h[3] + v[4] + vp[0];
+            h[3] = h[4] + v[0] + vp[1]; h[4] = h[0] + v[1] + vp[2]; h[0] = T;
+        }
+    }
+
+    class Hasher
+    {
+    public:
+        Hasher() : H(Detail::initial()), bufferSize(0), totalBytes(0) {}
+
+        void Update(const unsigned char* byteStream, size_t sizeInBytes)
+        {
+            totalBytes += sizeInBytes;
+
+            // Complete a partial block left over from the previous update
+            if (bufferSize > 0)
             {
-                T = rol(A + f(j, B, C, D) + X_i[r[j]] + K(j), s[j]) + E;
-                A = E; E = D; D = rol(C, 10); C = B; B = T;
-                T = rol(Ap + f(79 - j, Bp, Cp, Dp) + X_i[rp[j]] + Kp(j), sp[j]) + Ep;
-                Ap = Ep; Ep = Dp; Dp = rol(Cp, 10); Cp = Bp; Bp = T;
+                const size_t bytesToCopy = std::min(buffer.size() - bufferSize, sizeInBytes);
+                std::copy(byteStream, byteStream + bytesToCopy, buffer.begin() + bufferSize);
+                bufferSize += bytesToCopy;
+                byteStream += bytesToCopy;
+                sizeInBytes -= bytesToCopy;
+                if (bufferSize < buffer.size())
+                    return;
+                ProcessBlock(&buffer[0]);
+                bufferSize = 0;
             }
-            T = h[1] + C + Dp; h[1] = h[2] + D + Ep; h[2] = h[3] + E + Ap;
-            h[3] = h[4] + A + Bp; h[4] = h[0] + B + Cp; h[0] = T;
+
+            // All the full 512-bit blocks can be processed immediately in streaming fashion, straight from the caller's memory
+            for (; sizeInBytes >= buffer.size(); byteStream += buffer.size(), sizeInBytes -= buffer.size())
+                ProcessBlock(byteStream);
+
+            std::copy(byteStream, byteStream + sizeInBytes, buffer.begin());
+            bufferSize = sizeInBytes;
+        }
+
+        Hash Finalize()
+        {
+            // Add the one bit after the message data, then k zero bits where l + 1 + k = 448 (mod 512)
+            buffer[bufferSize++] = 0x80;
+            if (bufferSize > 56)
+            {
+                std::fill(buffer.begin() + bufferSize, buffer.end(), 0);
+                ProcessBlock(&buffer[0]);
+                bufferSize = 0;
+            }
+            std::fill(buffer.begin() + bufferSize, buffer.begin() + 56, 0);
+
+            // Add the message size in bits as a little-endian 64-bit integer
+            const uint64_t messageSizeInBits = totalBytes << 3;
+            for (size_t i = 0; i < 8; ++i)
+                buffer[56 + i] = static_cast<unsigned char>(messageSizeInBits >> (8 * i));
+            ProcessBlock(&buffer[0]);
+
+            return H;
         }
-    }
+
+    private:
+        void ProcessBlock(const unsigned char* block)
+        {
+            // According to the MD4 spec, words are little-endian. Loading byte by byte means the block needn't be aligned.
+            std::array<uint32_t, 16> X;
+            for (size_t i = 0; i < X.size(); ++i, block += 4)
+                X[i] = block[0] | (uint32_t(block[1]) << 8) | (uint32_t(block[2]) << 16) | (uint32_t(block[3]) << 24);
+            Detail::Process16WordBlock(&X[0], H);
+        }
+
+        Hash H;
+        std::array<unsigned char, 64> buffer;
+        size_t bufferSize;
+        uint64_t totalBytes;
+    };
 
     inline Hash Compute(const unsigned char* byteStream, size_t sizeInBytes)
     {
-        using namespace Detail;
-
-        Hash H = initial();
-        size_t bytesProcessed = 0;
-        constexpr size_t bytesPerBlock = 64;
-
-        // All the full 512-bit blocks can be processed immediately in streaming fashion
-        // According to the MD4 spec, we leave the words in their native little-endian format
-        for (; sizeInBytes - bytesProcessed >= bytesPerBlock; bytesProcessed += bytesPerBlock)
-            Process16WordBlock(reinterpret_cast<const uint32_t*>(byteStream + bytesProcessed), H);
-
-        std::array<uint32_t, 32> localWords = {}; // Initialize blocks to zero bits
-        uint8_t* localBytes = reinterpret_cast<uint8_t*>(&localWords[0]);
-
-        // Copy the message data without reversing endian-ness
-        std::copy(byteStream + bytesProcessed, byteStream + sizeInBytes, localBytes);
-
-        // Add the one bit after lBits of message data
-        const uint32_t bytesRemaining = static_cast<uint32_t>(sizeInBytes - bytesProcessed);
-        localBytes[bytesRemaining] = 0x80;
-
-        // Add the message size in bits
-        const uint32_t lBits = bytesRemaining << 3; // l bits of the message remaining
-        const uint32_t zeroBits = lBits <= 447 ? 447 - lBits : 512 + 447 - lBits; // k zero bits where l + 1 + k = 448 (mod 512)
-        const uint32_t messageSizeWordPos = (lBits + 1 + zeroBits) >> 5; // The message size goes after the zero padding bits
-        const uint64_t messageSizeInBits = sizeInBytes << 3;
-        const uint32_t messageSizeLoWord = static_cast<uint32_t>(messageSizeInBits);
-        const uint32_t messageSizeHiWord = static_cast<uint32_t>(messageSizeInBits >> 32);
-        localWords[messageSizeWordPos] = messageSizeLoWord;
-        localWords[messageSizeWordPos + 1] = messageSizeHiWord;
-
-        // Process the remaining blocks
-        Process16WordBlock(&localWords[0], H);
-        if (lBits >= 448) // messageSizeWordPos + 1 >= 16
-            Process16WordBlock(&localWords[16], H);
-
-        // Return the final hash value
-        return H;
+        Hasher hasher;
+        hasher.Update(byteStream, sizeInBytes);
+        return hasher.Finalize();
     }
 
     template <typename Iter> Hash Compute(Iter begin, Iter end)
@@ -146,6 +200,19 @@ namespace RIPEMD160
         const size_t bytes = diff * sizeof(std::remove_reference_t<decltype(*begin)>);
         return Compute(bytes == 0 ? nullptr : reinterpret_cast<const unsigned char*>(&*begin), bytes);
     }
+
+    inline Hash Compute(std::span<const std::span<const unsigned char>> pieces)
+    {
+        Hasher hasher;
+        for (const auto& piece : pieces)
+            hasher.Update(piece.data(), piece.size());
+        return hasher.Finalize();
+    }
+
+    inline Hash Compute(std::initializer_list<std::span<const unsigned char>> pieces)
+    {
+        return Compute(std::span<const std::span<const unsigned char>>(pieces.begin(), pieces.size()));
+    }
 }
 
 //std::ostream& operator <<(std::ostream& os, const RIPEMD160::Hash& h)
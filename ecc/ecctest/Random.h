@@ -0,0 +1,213 @@
+#pragma once
+
+/*
+* A fast cryptographically secure random generator, for private keys and nonces.
+*
+* std::random_device typically makes a system call for every 32-bit word. SecureGenerator instead expands a 256-bit
+* key from the operating system (getrandom on Linux, BCryptGenRandom on Windows) with the ChaCha20 block function,
+* buffering the output per thread. After each refill, the first 32 bytes of new output replace the key, so earlier
+* output can't be recovered from the state. The key is drawn from the system again every ReseedInterval bytes,
+* and in a child process after fork, so that parent and child never share output.
+*
+* SecureGenerator satisfies the Rnd parameter of EllipticCurve (and UniformRandomBitGenerator in general).
+* Fill writes any number of bytes in one call, which GenerateRandomPrivateKey uses to draw whole scalars at a time.
+*/
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <span>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <bcrypt.h>
+#pragma comment(lib, "bcrypt.lib")
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sys/random.h>
+#else
+#include <pthread.h>
+#endif
+
+namespace Random
+{
+    class SecureGenerator
+    {
+    public:
+        using result_type = uint32_t;
+
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+        result_type operator ()();
+
+        void Fill(std::span<std::byte> bytes);
+    };
+
+    // The ChaCha20 block function of RFC 8439: 64 bytes of key stream for a key, block counter and nonce
+    std::array<uint32_t, 16> ChaCha20Block(const std::array<uint32_t, 8>& key, uint32_t counter, const std::array<uint32_t, 3>& nonce);
+}
+
+
+/* Implementation follows */
+
+namespace Random
+{
+namespace Detail
+{
+    constexpr size_t BlocksPerRefill = 16;
+    constexpr uint64_t ReseedInterval = uint64_t(1) << 20;
+
+    constexpr uint32_t RotateLeft(uint32_t x, int count)
+    {
+        return (x << count) | (x >> (32 - count));
+    }
+
+    constexpr void QuarterRound(std::array<uint32_t, 16>& x, size_t a, size_t b, size_t c, size_t d)
+    {
+        x[a] += x[b]; x[d] = RotateLeft(x[d] ^ x[a], 16);
+        x[c] += x[d]; x[b] = RotateLeft(x[b] ^ x[c], 12);
+        x[a] += x[b]; x[d] = RotateLeft(x[d] ^ x[a], 8);
+        x[c] += x[d]; x[b] = RotateLeft(x[b] ^ x[c], 7);
+    }
+
+    // Fill with bytes from the operating system
+    inline void SystemEntropy(void* data, size_t size)
+    {
+#if defined(_WIN32)
+        if (BCryptGenRandom(nullptr, static_cast<PUCHAR>(data), static_cast<ULONG>(size), BCRYPT_USE_SYSTEM_PREFERRED_RNG) != 0)
+            throw std::runtime_error("BCryptGenRandom failed");
+#elif defined(__linux__)
+        for (uint8_t* p = static_cast<uint8_t*>(data); size > 0; )
+        {
+            const ssize_t count = getrandom(p, size, 0);
+            if (count < 0)
+                throw std::runtime_error("getrandom failed");
+            p += count;
+            size -= static_cast<size_t>(count);
+        }
+#else
+        std::random_device device;
+        for (uint8_t* p = static_cast<uint8_t*>(data); size > 0; --size)
+            *p++ = static_cast<uint8_t>(device());
+#endif
+    }
+
+    // Incremented in the child after every fork, so each thread's state can tell that it must reseed
+    inline std::atomic<uint64_t> s_forkCount = 0;
+
+    inline uint64_t ForkCount()
+    {
+#if !defined(_WIN32)
+        static const bool registered = pthread_atfork(nullptr, nullptr, []() { ++s_forkCount; }) == 0;
+        (void)registered;
+#endif
+        return s_forkCount.load(std::memory_order_relaxed);
+    }
+
+    class State
+    {
+    public:
+        void Fill(std::span<std::byte> bytes)
+        {
+            if (forkCount != ForkCount() || bytesSinceSeed >= ReseedInterval)
+                Seed();
+            while (!bytes.empty())
+            {
+                if (position == buffer.size())
+                    Refill();
+                const size_t count = std::min(bytes.size(), buffer.size() - position);
+                std::memcpy(bytes.data(), buffer.data() + position, count);
+                std::memset(buffer.data() + position, 0, count); // Output is never handed out twice
+                position += count;
+                bytes = bytes.subspan(count);
+            }
+        }
+
+    private:
+        void Seed()
+        {
+            SystemEntropy(key.data(), sizeof(key));
+            forkCount = ForkCount();
+            bytesSinceSeed = 0;
+            counter = 0;
+            position = buffer.size();
+        }
+
+        void Refill()
+        {
+            std::array<uint32_t, 16 * BlocksPerRefill> stream;
+            for (size_t block = 0; block < BlocksPerRefill; ++block)
+            {
+                const auto words = ChaCha20Block(key, counter++, {});
+                std::copy(words.begin(), words.end(), stream.begin() + 16 * block);
+            }
+
+            // Fast key erasure: the first 32 bytes become the next key, and are never output
+            std::copy(stream.begin(), stream.begin() + key.size(), key.begin());
+            std::memcpy(buffer.data(), stream.data() + key.size(), buffer.size());
+            std::memset(stream.data(), 0, sizeof(stream));
+            counter = 0;
+            position = 0;
+            bytesSinceSeed += buffer.size();
+        }
+
+        std::array<uint32_t, 8> key = {};
+        uint32_t counter = 0;
+        std::array<std::byte, 64 * BlocksPerRefill - 32> buffer = {};
+        size_t position = buffer.size();
+        uint64_t bytesSinceSeed = ReseedInterval; // Seed on first use
+        uint64_t forkCount = 0;
+    };
+
+    inline State& ThreadState()
+    {
+        thread_local State state;
+        return state;
+    }
+}
+
+inline std::array<uint32_t, 16> ChaCha20Block(const std::array<uint32_t, 8>& key, uint32_t counter, const std::array<uint32_t, 3>& nonce)
+{
+    // "expand 32-byte k", then the key, counter and nonce
+    const std::array<uint32_t, 16> input = { 0x61707865, 0x3320646e, 0x79622d32, 0x6b206574,
+                                             key[0], key[1], key[2], key[3], key[4], key[5], key[6], key[7],
+                                             counter, nonce[0], nonce[1], nonce[2] };
+    auto x = input;
+    for (int round = 0; round < 10; ++round)
+    {
+        Detail::QuarterRound(x, 0, 4, 8, 12);
+        Detail::QuarterRound(x, 1, 5, 9, 13);
+        Detail::QuarterRound(x, 2, 6, 10, 14);
+        Detail::QuarterRound(x, 3, 7, 11, 15);
+        Detail::QuarterRound(x, 0, 5, 10, 15);
+        Detail::QuarterRound(x, 1, 6, 11, 12);
+        Detail::QuarterRound(x, 2, 7, 8, 13);
+        Detail::QuarterRound(x, 3, 4, 9, 14);
+    }
+    for (size_t i = 0; i < x.size(); ++i)
+        x[i] += input[i];
+    return x;
+}
+
+inline SecureGenerator::result_type SecureGenerator::operator ()()
+{
+    result_type x;
+    Fill(std::as_writable_bytes(std::span(&x, 1)));
+    return x;
+}
+
+inline void SecureGenerator::Fill(std::span<std::byte> bytes)
+{
+    Detail::ThreadState().Fill(bytes);
+}
+}
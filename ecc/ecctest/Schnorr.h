@@ -0,0 +1,218 @@
+#pragma once
+
+/*
+* Schnorr signatures on secp256k1, as specified in BIP 340 for Taproot.
+*
+* Public keys are x-only: 32 bytes of x, standing for the point with that x and even y. A signer whose key has an odd y
+* negates the private key, and likewise the nonce, so the nonce point R of a signature is also carried by its x alone.
+* The nonce and challenge come from the tagged hashes of sha256.h, whose tag prefixes are hashed at compile time.
+*
+* VerifyBatch checks many signatures with one multi-scalar multiplication. With random weights a_i, it checks
+* (sum a_i s_i) G = sum a_i R_i + sum a_i e_i P_i, which all valid signatures satisfy and a batch with an invalid one
+* satisfies only with probability 2^-128. The terms share a single run of doublings (see EllipticCurve::MultiplyMulti),
+* the weights are 128-bit so the R_i terms need half the additions, and all the window tables share one inversion,
+* so each further signature costs a fraction of a single verification.
+*/
+
+#include "Bitcoin.h"
+#include "Random.h"
+
+#include <cstring>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+namespace Schnorr
+{
+    using XOnlyPublicKey = ByteArray<32>;
+    using Signature = ByteArray<64>; // x of R || s
+
+    XOnlyPublicKey PublicKey(const Bitcoin::PrivateKey& privateKey);
+
+    // Sign with the given 32 bytes of auxiliary randomness. All zeros gives deterministic signatures,
+    // as the nonce also depends on the private key and the message.
+    Signature Sign(const Bitcoin::PrivateKey& privateKey, std::span<const uint8_t> message, std::span<const uint8_t, 32> auxRand);
+
+    // Sign with auxiliary randomness drawn from rnd
+    template <typename Rnd>
+    Signature Sign(const Bitcoin::PrivateKey& privateKey, std::span<const uint8_t> message, Rnd& rnd);
+
+    bool Verify(const XOnlyPublicKey& publicKey, std::span<const uint8_t> message, const Signature& signature);
+
+    // True if all the signatures verify. Not knowing which failed, a caller with a false result can fall back to Verify.
+    bool VerifyBatch(std::span<const XOnlyPublicKey> publicKeys, std::span<const std::span<const uint8_t>> messages, std::span<const Signature> signatures);
+}
+
+
+/* Implementation follows */
+
+namespace Schnorr
+{
+namespace Detail
+{
+    using EC = Bitcoin::EC;
+
+    inline std::array<uint8_t, 32> Bytes(const EC::Wide& x)
+    {
+        std::array<uint8_t, 32> bytes;
+        x.ToBigEndianBytes(bytes.data(), bytes.size());
+        return bytes;
+    }
+
+    // A hash as an integer: the first word is the most significant
+    inline EC::Wide HashToInt(const SHA256::Hash& hash)
+    {
+        EC::Wide x;
+        for (size_t i = 0; i < hash.size(); ++i)
+            x.m_a[i] = hash[hash.size() - 1 - i];
+        return x;
+    }
+
+    // e = hash_challenge(x of R || x of P || message) mod n
+    inline EC::Mod_n Challenge(const uint8_t* r, const uint8_t* publicKey, std::span<const uint8_t> message)
+    {
+        auto hasher = SHA256::TaggedHasher<"BIP0340/challenge">();
+        hasher.Update(r, 32);
+        hasher.Update(publicKey, 32);
+        hasher.Update(message.data(), message.size());
+        return HashToInt(hasher.Finalize());
+    }
+
+    // The point with the given x and even y. Returns false if x is not in the field or not the x of a point on the curve.
+    inline bool LiftX(const EC::Wide& x, EC::Point& point)
+    {
+        return EC::TryDecompress(x, false, point);
+    }
+
+    // The random weight a_i of signature i in a batch. The weights come from a ChaCha20 stream keyed by a hash
+    // of the whole batch, as BIP 340 suggests, so they can't be known before the batch is fixed.
+    // Weight 0 is 1, which is as good as random: only the ratios between the weights matter.
+    inline EC::Wide BatchWeight(const SHA256::Hash& seed, size_t i)
+    {
+        EC::Wide weight = 1u;
+        if (i > 0)
+        {
+            const auto block = Random::ChaCha20Block(seed, static_cast<uint32_t>(i), {});
+            std::copy(block.begin(), block.begin() + 4, weight.m_a.begin()); // 128 bits
+        }
+        return weight;
+    }
+}
+
+inline XOnlyPublicKey PublicKey(const Bitcoin::PrivateKey& privateKey)
+{
+    return Detail::Bytes(Bitcoin::EC::PrivateKeyToPublicKey(privateKey).x.Value());
+}
+
+inline Signature Sign(const Bitcoin::PrivateKey& privateKey, std::span<const uint8_t> message, std::span<const uint8_t, 32> auxRand)
+{
+    using EC = Detail::EC;
+    const EC::Point P = EC::PrivateKeyToPublicKey(privateKey);
+    const EC::Mod_n d = P.y.Value().IsOdd() ? -EC::Mod_n(privateKey) : EC::Mod_n(privateKey);
+    const auto publicKey = Detail::Bytes(P.x.Value());
+
+    // t = bytes(d) XOR hash_aux(a), then k' = hash_nonce(t || bytes(P) || message) mod n
+    const auto dBytes = Detail::Bytes(d.x);
+    const auto auxHash = ToBytesAsBigEndian(SHA256::TaggedHash<"BIP0340/aux">(auxRand.data(), auxRand.size()));
+    std::array<uint8_t, 32> t;
+    for (size_t i = 0; i < t.size(); ++i)
+        t[i] = dBytes[i] ^ auxHash.data()[i];
+    auto nonceHasher = SHA256::TaggedHasher<"BIP0340/nonce">();
+    nonceHasher.Update(t.data(), t.size());
+    nonceHasher.Update(publicKey.data(), publicKey.size());
+    nonceHasher.Update(message.data(), message.size());
+    const EC::Mod_n kPrime = Detail::HashToInt(nonceHasher.Finalize());
+    if (kPrime.IsZero())
+        throw std::runtime_error("Nonce is zero"); // Probability 2^-256
+
+    const EC::Point R = EC::GeneratorTable().Multiply(kPrime.x);
+    const EC::Mod_n k = R.y.Value().IsOdd() ? -kPrime : kPrime;
+    const auto r = Detail::Bytes(R.x.Value());
+    const EC::Mod_n s = k + Detail::Challenge(r.data(), publicKey.data(), message) * d;
+
+    Signature signature;
+    std::copy(r.begin(), r.end(), signature.begin());
+    s.x.ToBigEndianBytes(signature.data() + 32, 32);
+    return signature;
+}
+
+template <typename Rnd>
+Signature Sign(const Bitcoin::PrivateKey& privateKey, std::span<const uint8_t> message, Rnd& rnd)
+{
+    std::array<uint8_t, 32> auxRand;
+    if constexpr (requires { rnd.Fill(std::as_writable_bytes(std::span(auxRand))); })
+        rnd.Fill(std::as_writable_bytes(std::span(auxRand)));
+    else
+    {
+        std::uniform_int_distribution<uint32_t> uniform;
+        for (size_t i = 0; i < auxRand.size(); i += 4)
+        {
+            const uint32_t word = uniform(rnd);
+            std::memcpy(&auxRand[i], &word, 4);
+        }
+    }
+    return Sign(privateKey, message, std::span<const uint8_t, 32>(auxRand));
+}
+
+inline bool Verify(const XOnlyPublicKey& publicKey, std::span<const uint8_t> message, const Signature& signature)
+{
+    using EC = Detail::EC;
+    EC::Point P;
+    if (!Detail::LiftX(EC::Wide::FromBigEndianBytes(publicKey.data(), 32), P))
+        return false;
+    const EC::Wide r = EC::Wide::FromBigEndianBytes(signature.data(), 32);
+    const EC::Wide s = EC::Wide::FromBigEndianBytes(signature.data() + 32, 32);
+    if (r >= secp256k1::p || s >= secp256k1::n)
+        return false;
+
+    // R = s G - e P
+    const EC::Mod_n e = Detail::Challenge(signature.data(), publicKey.data(), message);
+    const EC::Point R = EC::MultiplyJoint(s, (-e).x, P);
+    return !R.IsInfinity() && !R.y.Value().IsOdd() && R.x.Value() == r;
+}
+
+inline bool VerifyBatch(std::span<const XOnlyPublicKey> publicKeys, std::span<const std::span<const uint8_t>> messages, std::span<const Signature> signatures)
+{
+    using EC = Detail::EC;
+    const size_t count = signatures.size();
+    if (publicKeys.size() != count || messages.size() != count)
+        throw std::invalid_argument("Expected one public key and one message per signature");
+
+    auto seedHasher = SHA256::TaggedHasher<"BIP0340/batch">();
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint64_t messageSize = messages[i].size(); // So that no two batches hash the same
+        seedHasher.Update(publicKeys[i].data(), publicKeys[i].size());
+        seedHasher.Update(reinterpret_cast<const uint8_t*>(&messageSize), sizeof(messageSize));
+        seedHasher.Update(messages[i].data(), messages[i].size());
+        seedHasher.Update(signatures[i].data(), signatures[i].size());
+    }
+    const SHA256::Hash seed = seedHasher.Finalize();
+
+    // Terms a_i R_i and a_i e_i P_i, alternately, and the sum of a_i s_i for G
+    std::vector<EC::Point> points(2 * count);
+    std::vector<EC::Wide> scalars(2 * count);
+    EC::Mod_n sSum = 0u;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const EC::Wide r = EC::Wide::FromBigEndianBytes(signatures[i].data(), 32);
+        const EC::Wide s = EC::Wide::FromBigEndianBytes(signatures[i].data() + 32, 32);
+        if (s >= secp256k1::n)
+            return false;
+        if (!Detail::LiftX(r, points[2 * i]) || !Detail::LiftX(EC::Wide::FromBigEndianBytes(publicKeys[i].data(), 32), points[2 * i + 1]))
+            return false;
+
+        const EC::Mod_n weight = Detail::BatchWeight(seed, i);
+        const EC::Mod_n e = Detail::Challenge(signatures[i].data(), publicKeys[i].data(), messages[i]);
+        scalars[2 * i] = weight.x;
+        scalars[2 * i + 1] = (weight * e).x;
+        sSum = sSum + weight * EC::Mod_n(s);
+    }
+
+    std::vector<EC::WindowTable> tables(points.size());
+    EC::BuildWindowTables(points, tables);
+    const EC::JacobianPoint sum = EC::GeneratorTable().MultiplyJacobian((-sSum).x, EC::MultiplyMulti(std::span<const EC::Wide>(scalars), std::span<const EC::WindowTable>(tables)));
+    return sum.IsInfinity();
+}
+}
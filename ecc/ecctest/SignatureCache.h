@@ -0,0 +1,184 @@
+#pragma once
+
+/*
+* A cache of successful signature verifications.
+*
+* A transaction is usually verified twice, once on entering the mempool and again when its block is connected.
+* The cache remembers each (public key, message digest, signature) triple that verified, as a SHA-256 hash salted with
+* 64 random bytes, so entries can't be predicted or forced to collide. A second verification is then one hash and a lookup.
+*
+* The table is fixed in size and set-associative: each entry can live in one of the 4 slots of the bucket its hash selects,
+* and the oldest occupant is overwritten when all 4 are taken. Lookups and erasures are lock-free; only inserts take a lock.
+*/
+
+#include "Bitcoin.h"
+#include "Random.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <span>
+
+namespace SignatureCache
+{
+    struct Statistics
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t insertions = 0;
+        size_t slotCount = 0;
+        size_t byteCount = 0;
+
+        double HitRate() const
+        {
+            return hits + misses > 0 ? double(hits) / (hits + misses) : 0;
+        }
+    };
+
+    class Cache
+    {
+    public:
+        using Entry = SHA256::Hash;
+
+        // A table of (about) the given size, with a fresh random salt
+        explicit Cache(size_t megabytes);
+
+        // The salted hash that identifies one verification
+        Entry ComputeEntry(const Bitcoin::PublicKey& publicKey, const Bitcoin::LongHash& digest, const Bitcoin::CompactSignature& signature) const;
+
+        // Lock-free lookup. With erase, a hit also removes the entry, e.g. at block connection, after which it is not needed again.
+        bool Contains(const Entry& entry, bool erase = false);
+
+        void Insert(const Entry& entry);
+
+        Statistics GetStatistics() const;
+
+    private:
+        static constexpr size_t SlotsPerBucket = 4;
+
+        // Word 0 of a slot is written last and is zero when the slot is empty
+        using Slot = std::array<std::atomic<uint32_t>, std::tuple_size_v<Entry>>;
+        struct alignas(64) Bucket
+        {
+            std::array<Slot, SlotsPerBucket> slots;
+            std::atomic<uint32_t> next; // The slot to overwrite when all are taken
+        };
+
+        Bucket& BucketOf(const Entry& entry) { return buckets[entry[0] % bucketCount]; }
+
+        size_t bucketCount;
+        std::unique_ptr<Bucket[]> buckets;
+        SHA256::Hasher saltedHasher; // The hash state after the salt
+        std::mutex insertMutex;
+        std::atomic<uint64_t> hits = 0, misses = 0, insertions = 0;
+    };
+
+    // Verify a DER signature as Bitcoin::Verify does, but return at once if the same verification is cached,
+    // and cache it if it succeeds
+    template <typename Iter>
+    bool Verify(Cache& cache, const Bitcoin::PublicKey& publicKey, Iter begin, Iter end, std::span<const uint8_t> signature, bool eraseOnHit = false);
+}
+
+
+/* Implementation follows */
+
+namespace SignatureCache
+{
+inline Cache::Cache(size_t megabytes) : bucketCount(std::max<size_t>(1, (megabytes << 20) / sizeof(Bucket))), buckets(new Bucket[bucketCount]())
+{
+    std::array<uint32_t, 16> salt;
+    Random::SecureGenerator().Fill(std::as_writable_bytes(std::span(salt)));
+    saltedHasher.Update(reinterpret_cast<const uint8_t*>(salt.data()), sizeof(salt));
+}
+
+inline Cache::Entry Cache::ComputeEntry(const Bitcoin::PublicKey& publicKey, const Bitcoin::LongHash& digest, const Bitcoin::CompactSignature& signature) const
+{
+    const auto key = publicKey.Compressed();
+    SHA256::Hasher hasher = saltedHasher;
+    hasher.Update(key.data(), key.size());
+    hasher.Update(digest.data(), digest.size());
+    hasher.Update(signature.data(), signature.size());
+    return hasher.Finalize();
+}
+
+inline bool Cache::Contains(const Entry& entry, bool erase)
+{
+    // A slot read while it is being overwritten can mix words of two entries. That can't produce a false hit:
+    // both entries would have to agree with this one in some words, and the words of a salted hash are unpredictable.
+    for (Slot& slot : BucketOf(entry).slots)
+    {
+        if (slot[0].load(std::memory_order_acquire) != entry[0])
+            continue;
+        bool match = true;
+        for (size_t i = 1; i < entry.size() && match; ++i)
+            match = slot[i].load(std::memory_order_relaxed) == entry[i];
+        if (!match)
+            continue;
+
+        if (erase)
+        {
+            uint32_t expected = entry[0];
+            slot[0].compare_exchange_strong(expected, 0, std::memory_order_relaxed);
+        }
+        ++hits;
+        return true;
+    }
+    ++misses;
+    return false;
+}
+
+inline void Cache::Insert(const Entry& entry)
+{
+    if (entry[0] == 0) // Reserved for empty slots. One entry in 2^32 is simply not cached.
+        return;
+
+    std::lock_guard lock(insertMutex);
+    Bucket& bucket = BucketOf(entry);
+    Slot* target = nullptr;
+    for (Slot& slot : bucket.slots)
+    {
+        const uint32_t first = slot[0].load(std::memory_order_relaxed);
+        if (first == entry[0])
+            return; // Already cached (almost certainly)
+        if (first == 0 && !target)
+            target = &slot;
+    }
+    if (!target)
+        target = &bucket.slots[bucket.next++ % SlotsPerBucket];
+
+    // Empty the slot, fill in the other words, then publish with word 0
+    (*target)[0].store(0, std::memory_order_relaxed);
+    for (size_t i = 1; i < entry.size(); ++i)
+        (*target)[i].store(entry[i], std::memory_order_relaxed);
+    (*target)[0].store(entry[0], std::memory_order_release);
+    ++insertions;
+}
+
+inline Statistics Cache::GetStatistics() const
+{
+    Statistics statistics;
+    statistics.hits = hits;
+    statistics.misses = misses;
+    statistics.insertions = insertions;
+    statistics.slotCount = bucketCount * SlotsPerBucket;
+    statistics.byteCount = bucketCount * sizeof(Bucket);
+    return statistics;
+}
+
+template <typename Iter>
+bool Verify(Cache& cache, const Bitcoin::PublicKey& publicKey, Iter begin, Iter end, std::span<const uint8_t> signature, bool eraseOnHit)
+{
+    const auto decoded = DER::DecodeSignature<256>(signature);
+
+    // Hash the message once, for both the cache entry and the verification
+    const Bitcoin::LongHash digest = Bitcoin::SHA256Hash(begin, end);
+    const Cache::Entry entry = cache.ComputeEntry(publicKey, digest, Compact::FromPair(decoded));
+    if (cache.Contains(entry, eraseOnHit))
+        return true;
+
+    if (!Bitcoin::EC::VerifyDigest(publicKey, decoded, digest.Span()))
+        return false;
+    cache.Insert(entry);
+    return true;
+}
+}
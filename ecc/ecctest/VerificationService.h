@@ -0,0 +1,286 @@
+#pragma once
+
+/*
+* Signature verification on a pool of worker threads.
+*
+* A Service owns its workers, and each worker owns a deque of tasks. A worker takes tasks from the back of its own deque,
+* and when that is empty, steals from the front of the others', so the load evens out without a central queue.
+*
+* Each submitted chunk of jobs runs as a two-stage pipeline. The first stage decodes the DER signatures and hashes
+* the messages of a slice of GrainSize jobs. It then queues one second-stage task per job that decoded, which validates
+* the public key and does the double scalar multiplication. Second-stage tasks go on the worker's own deque, where
+* idle workers can steal them while it prepares the next slice. Results come back through a future or a callback.
+*/
+
+#include "Bitcoin.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace Verification
+{
+    // One signature to verify. The message bytes are not copied, so must stay alive until the job completes.
+    struct Job
+    {
+        Bitcoin::PublicKey publicKey;
+        std::span<const uint8_t> message;
+        Bitcoin::Signature signature;
+    };
+
+    // One byte per job, in order: 1 if the signature verified, 0 if not (including invalid encodings and public keys)
+    using Results = std::vector<uint8_t>;
+
+    class Service
+    {
+    public:
+        static constexpr size_t GrainSize = 16; // Jobs per first-stage task
+
+        // threadCount = 0 uses all hardware threads
+        explicit Service(unsigned threadCount = 0);
+        ~Service(); // Finishes all submitted work first
+
+        Service(const Service&) = delete;
+        Service& operator =(const Service&) = delete;
+
+        std::future<Results> Submit(std::vector<Job> jobs);
+
+        // The completion is called once, on a worker thread, when every job in the chunk is done
+        void Submit(std::vector<Job> jobs, std::function<void(Results)> completion);
+
+        unsigned ThreadCount() const { return static_cast<unsigned>(workers.size()); }
+
+    private:
+        using Task = std::function<void(size_t worker)>;
+
+        struct Worker
+        {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+            std::thread thread;
+        };
+
+        struct Chunk;
+
+        void Push(size_t worker, Task task);
+        bool TryTake(size_t worker, Task& task);
+        void Run(size_t worker);
+
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::mutex idleMutex;
+        std::condition_variable idle;
+        std::atomic<size_t> pending = 0; // Tasks queued and not yet taken
+        std::atomic<size_t> nextWorker = 0; // Round robin for submissions
+        bool stopping = false;
+    };
+
+    struct Statistics
+    {
+        unsigned threadCount = 0;
+        uint64_t count = 0;
+        double seconds = 0;
+
+        double VerificationsPerSecond() const
+        {
+            return seconds > 0 ? count / seconds : 0;
+        }
+    };
+
+    // Verify the jobs on services of 1, 2, 4, ... threads, up to maxThreadCount (0 for all hardware threads)
+    std::vector<Statistics> Benchmark(std::span<const Job> jobs, unsigned maxThreadCount = 0);
+}
+
+
+/* Implementation follows */
+
+namespace Verification
+{
+struct Service::Chunk
+{
+    std::vector<Job> jobs;
+    std::vector<Bitcoin::EC::Signature> decoded;
+    std::vector<SHA256::Hash> hashes;
+    Results results;
+    std::atomic<size_t> remaining; // Jobs not yet finished
+    std::function<void(Results)> completion;
+
+    void Finish(size_t count)
+    {
+        if (remaining.fetch_sub(count) == count)
+            completion(std::move(results));
+    }
+};
+
+inline Service::Service(unsigned threadCount)
+{
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned i = 0; i < threadCount; ++i)
+        workers.push_back(std::make_unique<Worker>());
+    for (size_t i = 0; i < workers.size(); ++i)
+        workers[i]->thread = std::thread([this, i]() { Run(i); });
+}
+
+inline Service::~Service()
+{
+    {
+        std::lock_guard lock(idleMutex);
+        stopping = true;
+    }
+    idle.notify_all();
+    for (auto& worker : workers)
+        worker->thread.join();
+}
+
+inline std::future<Results> Service::Submit(std::vector<Job> jobs)
+{
+    auto promise = std::make_shared<std::promise<Results>>();
+    auto future = promise->get_future();
+    Submit(std::move(jobs), [promise](Results results) { promise->set_value(std::move(results)); });
+    return future;
+}
+
+inline void Service::Submit(std::vector<Job> jobs, std::function<void(Results)> completion)
+{
+    if (jobs.empty())
+    {
+        completion({});
+        return;
+    }
+
+    auto chunk = std::make_shared<Chunk>();
+    const size_t count = jobs.size();
+    chunk->jobs = std::move(jobs);
+    chunk->decoded.resize(count);
+    chunk->hashes.resize(count);
+    chunk->results.assign(count, 0);
+    chunk->remaining = count;
+    chunk->completion = std::move(completion);
+
+    for (size_t begin = 0; begin < count; begin += GrainSize)
+    {
+        const size_t end = std::min(begin + GrainSize, count);
+
+        // First stage: decode and hash the slice, then queue the curve arithmetic for each job that decoded
+        Push(nextWorker++ % workers.size(), [this, chunk, begin, end](size_t worker)
+        {
+            size_t failed = 0;
+            for (size_t i = begin; i < end; ++i)
+            {
+                const Job& job = chunk->jobs[i];
+                if (!DER::TryDecodeSignature<256>(job.signature, chunk->decoded[i]))
+                {
+                    ++failed;
+                    continue;
+                }
+                chunk->hashes[i] = SHA256::Compute(job.message.data(), job.message.size());
+
+                // Second stage: validate the public key and do the double scalar multiplication
+                Push(worker, [chunk, i](size_t)
+                {
+                    const Job& job = chunk->jobs[i];
+                    auto hashFunc = [&](const char*, const char*) { return chunk->hashes[i]; };
+                    chunk->results[i] = Bitcoin::EC::IsPublicKeyValid(job.publicKey) &&
+                        Bitcoin::EC::VerifySignatureForValidKey(job.publicKey, chunk->decoded[i], nullptr, 0, hashFunc);
+                    chunk->Finish(1);
+                });
+            }
+            if (failed > 0)
+                chunk->Finish(failed);
+        });
+    }
+}
+
+inline void Service::Push(size_t worker, Task task)
+{
+    {
+        std::lock_guard lock(workers[worker]->mutex);
+        workers[worker]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard lock(idleMutex);
+        ++pending;
+    }
+    idle.notify_one();
+}
+
+inline bool Service::TryTake(size_t worker, Task& task)
+{
+    // Newest first from our own deque, which is the most likely to be in cache
+    {
+        Worker& own = *workers[worker];
+        std::lock_guard lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    // Otherwise steal the oldest task of another worker, which is likely to be a first-stage task that creates more work
+    for (size_t k = 1; k < workers.size(); ++k)
+    {
+        Worker& victim = *workers[(worker + k) % workers.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void Service::Run(size_t worker)
+{
+    Task task;
+    while (true)
+    {
+        if (TryTake(worker, task))
+        {
+            --pending;
+            task(worker);
+            task = nullptr;
+            continue;
+        }
+
+        std::unique_lock lock(idleMutex);
+        idle.wait(lock, [this]() { return pending > 0 || stopping; });
+        if (stopping && pending == 0)
+            return;
+    }
+}
+
+inline std::vector<Statistics> Benchmark(std::span<const Job> jobs, unsigned maxThreadCount)
+{
+    if (maxThreadCount == 0)
+        maxThreadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<Statistics> sweep;
+    for (unsigned threadCount = 1; ; threadCount = std::min(2 * threadCount, maxThreadCount))
+    {
+        Service service(threadCount);
+        const auto start = std::chrono::steady_clock::now();
+        service.Submit(std::vector<Job>(jobs.begin(), jobs.end())).wait();
+
+        Statistics statistics;
+        statistics.threadCount = threadCount;
+        statistics.count = jobs.size();
+        statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        sweep.push_back(statistics);
+        if (threadCount == maxThreadCount)
+            break;
+    }
+    return sweep;
+}
+}
@@ -49,8 +49,7 @@ public:
         std::copy(a.begin(), a.end(), m_a.begin());
         EnforceBitLimit();
     }
-    constexpr UIntW(const UIntW& rhs) : m_a(rhs.m_a) {}
-    constexpr UIntW(UIntW&& rhs) : m_a(std::move(rhs.m_a)) {}
+    constexpr UIntW(const UIntW&) = default;
     constexpr UIntW(Base a) : m_a{ a }
     {
         EnforceBitLimit();
@@ -235,6 +234,41 @@ public:
         m_a[elementIndex] = (m_a[elementIndex] & ~byteMask) | ((Base)value << shiftBits);
     }
 
+    // Load from a big-endian byte string of up to Bits / 8 bytes, a whole element at a time
+    static constexpr UIntW FromBigEndianBytes(const uint8_t* bytes, size_t sizeInBytes)
+    {
+        if (sizeInBytes > ElementCount * sizeof(Base))
+            throw std::invalid_argument("Too many bytes for integer size");
+        UIntW x;
+        size_t i = 0;
+        for (const uint8_t* p = bytes + sizeInBytes; p - bytes >= (ptrdiff_t)sizeof(Base); ++i)
+        {
+            p -= sizeof(Base);
+            for (size_t k = 0; k < sizeof(Base); ++k)
+                x.m_a[i] = (x.m_a[i] << 8) | p[k];
+        }
+        for (size_t k = 0; k < sizeInBytes % sizeof(Base); ++k)
+            x.m_a[i] = (x.m_a[i] << 8) | bytes[k];
+        x.EnforceBitLimit();
+        return x;
+    }
+
+    // Store the low sizeInBytes bytes as a big-endian byte string, a whole element at a time
+    constexpr void ToBigEndianBytes(uint8_t* bytes, size_t sizeInBytes) const
+    {
+        size_t i = 0;
+        for (uint8_t* p = bytes + sizeInBytes; p - bytes >= (ptrdiff_t)sizeof(Base); ++i)
+        {
+            p -= sizeof(Base);
+            const Base element = i < ElementCount ? m_a[i] : 0;
+            for (size_t k = 0; k < sizeof(Base); ++k)
+                p[k] = static_cast<uint8_t>(element >> (8 * (sizeof(Base) - 1 - k)));
+        }
+        const Base element = i < ElementCount ? m_a[i] : 0;
+        for (size_t k = 0, partial = sizeInBytes % sizeof(Base); k < partial; ++k)
+            bytes[k] = static_cast<uint8_t>(element >> (8 * (partial - 1 - k)));
+    }
+
     template <size_t RBits>
     constexpr std::pair<UIntW<Bits>, UIntW<RBits>> DivideUnsignedQR(const UIntW<RBits>& rhs) const
     {
@@ -301,17 +335,7 @@ public:
         return operator =(ShiftLogicalRight(Shift));
     }
 
-    constexpr UIntW& operator =(UIntW&& rhs)
-    {
-        m_a = std::move(rhs.m_a);
-        return *this;
-    }
-
-    constexpr UIntW& operator =(const UIntW& rhs)
-    {
-        m_a = rhs.m_a;
-        return *this;
-    }
+    constexpr UIntW& operator =(const UIntW&) = default;
 
     template <size_t RBits>
     constexpr UIntW<std::max(Bits, RBits) + 1> AddExtend(const UIntW<RBits>& rhs) const
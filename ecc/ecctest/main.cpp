@@ -1,10 +1,17 @@
 #include "Bitcoin.h"
+#include "AddressBatch.h"
+#include "ECDH.h"
+#include "FieldLanes.h"
+#include "Random.h"
+#include "Schnorr.h"
+#include "VerificationService.h"
 
+#include <chrono>
 #include <iostream>
 
 int main()
 {
-    std::random_device random;
+    Random::SecureGenerator random;
 
     const auto privateKey = Bitcoin::GeneratePrivateKey(random);
     std::cout << "Private key: " << privateKey << std::endl;
@@ -25,5 +32,77 @@ int main()
     const bool isVerified = Bitcoin::Verify(publicKey, abc.begin(), abc.end(), signature);
     std::cout << "Verified: " << (isVerified ? "yes" : "no") << std::endl;
 
+    RFC6979::Nonces deterministic(privateKey);
+    const auto deterministicSignature = Bitcoin::Sign(privateKey, abc.begin(), abc.end(), deterministic);
+    std::cout << "Deterministic signature (RFC 6979): " << deterministicSignature << std::endl;
+
+    // RIPEMD-160: the spec's test vector for "abc", then the cost of one compression over a chain of blocks
+    const RIPEMD160::Hash ripemdAbc = { 0xf708b28e, 0x7a985de0, 0x8e4a049b, 0x87b0c698, 0xfc0b5af1 };
+    std::cout << "RIPEMD-160 test vector: " << (RIPEMD160::Compute(abc.begin(), abc.end()) == ripemdAbc ? "passed" : "FAILED") << std::endl;
+    std::array<uint32_t, 16> ripemdBlock = {};
+    RIPEMD160::Hash ripemdState = RIPEMD160::Detail::initial();
+    constexpr size_t ripemdBlockCount = 1 << 20;
+    const auto ripemdStart = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < ripemdBlockCount; ++i)
+    {
+        ripemdBlock[i % 16] ^= ripemdState[0]; // Each block depends on the last, so none can be skipped
+        RIPEMD160::Detail::Process16WordBlock(&ripemdBlock[0], ripemdState);
+    }
+    const double ripemdSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - ripemdStart).count();
+    std::cout << "RIPEMD-160 compression: " << 1e9 * ripemdSeconds / ripemdBlockCount << " ns/block" << std::endl;
+
+    // Batch address validation throughput, on addresses of random hashes with every tenth one corrupted
+    std::mt19937 generator(random());
+    std::vector<std::string> addresses(100000);
+    for (size_t i = 0; i < addresses.size(); ++i)
+    {
+        Bitcoin::ShortHash hash;
+        for (auto& byte : hash)
+            byte = static_cast<uint8_t>(generator());
+        addresses[i] = Base58Check::Encode(hash, i % 2 ? 0x00 : 0x05);
+        if (i % 10 == 0)
+            addresses[i][3] = addresses[i][3] == 'z' ? 'y' : 'z';
+    }
+    const std::vector<std::string_view> views(addresses.begin(), addresses.end());
+    std::vector<AddressBatch::Decoded> decoded(addresses.size());
+    const auto statistics = AddressBatch::Decode(views, decoded);
+    std::cout << std::dec << "Validated " << statistics.count << " addresses (" << statistics.validCount << " valid) at "
+              << statistics.AddressesPerSecond() << " addresses/s" << std::endl;
+
+    // Batch field multiplication throughput of the generic Fp<256, p>, scalar and at the widest lane count the CPU supports,
+    // against the scalar 5x52 field the curve actually uses, which lanes are not selected for
+    using Field = Fp<256, secp256k1::p>;
+    for (const size_t laneCount : { size_t(1), FieldLanes::WidestLaneCount() })
+    {
+        const auto fieldStatistics = FieldLanes::BenchmarkMultiply<Field>(laneCount == 1 ? 10000 : 100000, laneCount);
+        std::cout << "Fp field multiplication, " << fieldStatistics.laneCount << " lane(s): " << fieldStatistics.OperationsPerSecond() << " multiplications/s" << std::endl;
+    }
+    std::cout << "Fp field batches use " << FieldLanes::SelectedLaneCount<Field>() << " lane(s)" << std::endl;
+    const auto curveFieldStatistics = FieldLanes::BenchmarkMultiply<Bitcoin::EC::Mod_p>(100000, FieldLanes::SelectedLaneCount<Bitcoin::EC::Mod_p>());
+    std::cout << "5x52 field multiplication, " << curveFieldStatistics.laneCount << " lane(s): " << curveFieldStatistics.OperationsPerSecond() << " multiplications/s" << std::endl;
+
+    // Verification throughput on the thread pool, sweeping the thread count
+    const std::vector<Verification::Job> jobs(64, { publicKey, std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(abc.data()), abc.size()), signature });
+    for (const auto& verificationStatistics : Verification::Benchmark(jobs))
+        std::cout << "Verification, " << verificationStatistics.threadCount << " thread(s): " << verificationStatistics.VerificationsPerSecond() << " verifications/s" << std::endl;
+
+    // Schnorr (BIP 340) signature, then batch verification of 64 such signatures
+    const auto abcBytes = std::span<const uint8_t>(reinterpret_cast<const uint8_t*>(abc.data()), abc.size());
+    const auto schnorrSignature = Schnorr::Sign(privateKey, abcBytes, random);
+    std::cout << "Schnorr verified: " << (Schnorr::Verify(Schnorr::PublicKey(privateKey), abcBytes, schnorrSignature) ? "yes" : "no") << std::endl;
+    const std::vector<Schnorr::XOnlyPublicKey> schnorrKeys(64, Schnorr::PublicKey(privateKey));
+    const std::vector<std::span<const uint8_t>> schnorrMessages(64, abcBytes);
+    const std::vector<Schnorr::Signature> schnorrSignatures(64, schnorrSignature);
+    const auto start = std::chrono::steady_clock::now();
+    const bool batchVerified = Schnorr::VerifyBatch(schnorrKeys, schnorrMessages, schnorrSignatures);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Schnorr batch of 64 " << (batchVerified ? "verified" : "failed") << " at " << 64 / seconds << " verifications/s" << std::endl;
+
+    // ECDH: both sides of a key exchange derive the same secret
+    const auto peerPrivateKey = Bitcoin::GeneratePrivateKey(random);
+    const auto sharedSecret = ECDH::Derive(privateKey, Bitcoin::EC::PrivateKeyToPublicKey(peerPrivateKey).Compressed());
+    const auto peerSharedSecret = ECDH::Derive(peerPrivateKey, publicKey.Compressed());
+    std::cout << "ECDH shared secrets " << (std::equal(sharedSecret.begin(), sharedSecret.end(), peerSharedSecret.begin()) ? "agree" : "differ") << std::endl;
+
     return 0;
 }
\ No newline at end of file
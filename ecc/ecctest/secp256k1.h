@@ -1,6 +1,7 @@
 #pragma once
 
 #include "EC.h"
+#include "Field5x52.h"
 
 namespace secp256k1
 {
@@ -14,5 +15,6 @@ namespace secp256k1
     static constexpr Wide Gy = {{ 0xFB10D4B8, 0x9C47D08F, 0xA6855419, 0xFD17B448, 0x0E1108A8, 0x5DA4FBFC, 0x26A3C465, 0x483ADA77 }};
     static constexpr Wide  n = {{ 0xD0364141, 0xBFD25E8C, 0xAF48A03B, 0xBAAEDCE6, 0xFFFFFFFE, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF }};
 
-    using EC = EllipticCurve<256, p, a, b, Gx, Gy, n>;
+    // Coordinates use the lazily reduced 5x52 field
+    using EC = EllipticCurve<256, p, a, b, Gx, Gy, n, FieldElement<1>>;
 }
\ No newline at end of file
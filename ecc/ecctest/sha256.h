@@ -3,18 +3,57 @@
 // SHA-256
 // Implemented from the spec at https://nvlpubs.nist.gov/nistpubs/FIPS/NIST.FIPS.180-4.pdf
 
+#include "Lanes.h"
+
+#include <algorithm>
 #include <array>
+#include <initializer_list>
 #include <ostream>
+#include <span>
+#include <stdexcept>
 
 namespace SHA256
 {
     // 256 bits arranged in 8 DWORDs
     using Hash = std::array<uint32_t, 8>; 
 
-    // Compute the SHA-256 hash of an arbitrary byte stream
-    Hash Compute(const unsigned char* byteStream, size_t sizeInBytes);
+    // Compute the SHA-256 hash of an arbitrary byte stream.
+    // Everything here is constexpr, so hashes of constant data can be computed at compile time.
+    constexpr Hash Compute(const unsigned char* byteStream, size_t sizeInBytes);
+
+    // Any iterator range: contiguous bytes are hashed in place, other ranges element by element
+    template <typename Iter> constexpr Hash Compute(Iter begin, Iter end);
+
+    // Gather form: the hash of the concatenation of the pieces, e.g. Compute({ prefix.Span(), payload.Span() }),
+    // without copying them into one buffer first
+    constexpr Hash Compute(std::span<const std::span<const unsigned char>> pieces);
+    constexpr Hash Compute(std::initializer_list<std::span<const unsigned char>> pieces);
+
+    // Incremental hashing: Update with the message in pieces of any size, then Finalize.
+    // The result is the same as Compute over the concatenation of the pieces.
+    class Hasher;
+
+    // A string literal usable as a template argument, e.g. TaggedHash<"BIP0340/challenge">
+    template <size_t N>
+    struct TagString
+    {
+        constexpr TagString(const char (&literal)[N]) { std::copy(literal, literal + N, chars); }
+        constexpr size_t size() const { return N - 1; }
+        char chars[N] = {};
+    };
+
+    // Tagged hashes, SHA256(SHA256(tag) || SHA256(tag) || message), as in BIP 340.
+    // The hash state after the 64-byte prefix is computed at compile time for each tag, so the prefix costs nothing.
+    template <TagString tag> constexpr Hasher TaggedHasher();
+
+    template <TagString tag> constexpr Hash TaggedHash(const unsigned char* byteStream, size_t sizeInBytes);
 
-    template <typename Iter> Hash Compute(Iter begin, Iter end);
+    template <TagString tag, typename Iter> constexpr Hash TaggedHash(Iter begin, Iter end);
+
+    // The hash of each message, as Compute would give it, with LaneCount messages hashed at a time in lanes (see Lanes.h).
+    // Messages of different lengths simply drop out of the lock-step once their last block is done.
+    constexpr size_t LaneCount = 8;
+    void ComputeBatch(std::span<const std::span<const unsigned char>> messages, std::span<Hash> hashes);
 }
 
 // Write the hash digest to an output stream
@@ -23,7 +62,10 @@ std::ostream& operator <<(std::ostream& os, const SHA256::Hash& h);
 
 /* Implementation follows */
 
-#include <algorithm>
+#include <bit>
+#include <iterator>
+#include <memory>
+#include <type_traits>
 
 namespace SHA256
 {
@@ -44,71 +86,71 @@ namespace Detail
 
     using Block = std::array<uint32_t, 16>; // 512-bit message block
 
-    template <uint8_t Count> inline uint32_t ROTR(uint32_t x)
+    // The round functions are templated on the word type so that they apply equally to
+    // a single uint32_t and to Lanes<N, uint32_t> (N independent messages in lock-step).
+    template <uint8_t Count, typename Word> constexpr Word ROTR(const Word& x)
     {
         return (x >> Count) | (x << (32 - Count));
     }
 
-    template <uint8_t Count> inline uint32_t SHR(uint32_t x)
+    template <uint8_t Count, typename Word> constexpr Word SHR(const Word& x)
     {
         return x >> Count;
     }
 
-    inline uint32_t Ch(uint32_t x, uint32_t y, uint32_t z)
+    template <typename Word> constexpr Word Ch(const Word& x, const Word& y, const Word& z)
     {
         return (x & y) ^ (~x & z);
     }
 
-    inline uint32_t Maj(uint32_t x, uint32_t y, uint32_t z)
+    template <typename Word> constexpr Word Maj(const Word& x, const Word& y, const Word& z)
     {
         return (x & y) ^ (x & z) ^ (y & z);
     }
 
-    inline uint32_t Sigma_0(uint32_t x)
+    template <typename Word> constexpr Word Sigma_0(const Word& x)
     {
         return ROTR<2>(x) ^ ROTR<13>(x) ^ ROTR<22>(x);
     }
 
-    inline uint32_t Sigma_1(uint32_t x)
+    template <typename Word> constexpr Word Sigma_1(const Word& x)
     {
         return ROTR<6>(x) ^ ROTR<11>(x) ^ ROTR<25>(x);
     }
 
-    inline uint32_t sigma_0(uint32_t x)
+    template <typename Word> constexpr Word sigma_0(const Word& x)
     {
         return ROTR<7>(x) ^ ROTR<18>(x) ^ SHR<3>(x);
     }
 
-    inline uint32_t sigma_1(uint32_t x)
+    template <typename Word> constexpr Word sigma_1(const Word& x)
     {
         return ROTR<17>(x) ^ ROTR<19>(x) ^ SHR<10>(x);
     }
 
-    inline uint32_t ReverseEndianByteIndex(uint32_t index)
-    {
-        return (index & ~3) | (3 - (index & 3));
-    }
-
-    inline uint32_t ReverseEndianWord(uint32_t x)
+    template <typename Word> constexpr Word ReverseEndianWord(const Word& x)
     {
         return (x << 24) | ((x & 0x0000FF00) << 8) | ((x & 0x00FF0000) >> 8) | (x >> 24);
     }
 
-    inline void Process16WordBlock(const uint32_t* M, Schedule& W, Hash& H)
+    // Compute the message schedule entries W_t for t in [begin, 64), given the entries before begin
+    template <typename Word>
+    constexpr void ExpandSchedule(std::array<Word, 64>& W, uint8_t begin = 16)
     {
-        // Prepare the message schedule {W_t}
-        for (uint8_t t = 0; t < 16; ++t)
-            W[t] = M[t];
-        for (uint8_t t = 16; t < 64; ++t)
+        for (uint8_t t = begin; t < 64; ++t)
             W[t] = sigma_1(W[t - 2]) + W[t - 7] + sigma_0(W[t - 15]) + W[t - 16];
+    }
 
-        // Initialize the working variables a-h with the previous hash value
-        auto a = H[0], b = H[1], c = H[2], d = H[3], e = H[4], f = H[5], g = H[6], h = H[7];
+    // Apply the rounds t in [begin, end) to the working variables v = { a, b, c, d, e, f, g, h }
+    template <typename Word>
+    constexpr void ProcessRounds(std::array<Word, 8>& v, const std::array<Word, 64>& W, uint8_t begin = 0, uint8_t end = 64)
+    {
+        auto a = v[0], b = v[1], c = v[2], d = v[3], e = v[4], f = v[5], g = v[6], h = v[7];
 
-        for (uint8_t t = 0; t < 64; ++t)
+        for (uint8_t t = begin; t < end; ++t)
         {
-            const uint32_t T1 = h + Sigma_1(e) + Ch(e, f, g) + s_K[t] + W[t];
-            const uint32_t T2 = Sigma_0(a) + Maj(a, b, c);
+            const Word T1 = h + Sigma_1(e) + Ch(e, f, g) + s_K[t] + W[t];
+            const Word T2 = Sigma_0(a) + Maj(a, b, c);
             h = g;
             g = f;
             f = e;
@@ -119,70 +161,281 @@ namespace Detail
             a = T1 + T2;
         }
 
+        v = { a, b, c, d, e, f, g, h };
+    }
+
+    template <typename Word>
+    constexpr void Process16WordBlock(const Word* M, std::array<Word, 64>& W, std::array<Word, 8>& H)
+    {
+        // Prepare the message schedule {W_t}
+        for (uint8_t t = 0; t < 16; ++t)
+            W[t] = M[t];
+        ExpandSchedule(W);
+
+        // Initialize the working variables a-h with the previous hash value
+        auto v = H;
+        ProcessRounds(v, W);
+
         // Update the hash value
-        H[0] += a; H[1] += b; H[2] += c; H[3] += d;
-        H[4] += e; H[5] += f; H[6] += g; H[7] += h;
+        for (uint8_t i = 0; i < 8; ++i)
+            H[i] += v[i];
+    }
+}
+
+class Hasher
+{
+public:
+    constexpr Hasher() : Hasher(Detail::s_initialHash, 0) {}
+
+    // Resume from the hash value after a whole number of 64-byte blocks, e.g. a precomputed midstate
+    constexpr Hasher(const Hash& state, uint64_t bytesProcessed) : H(state), W{}, buffer{}, bufferSize(0), totalBytes(bytesProcessed) {}
+
+    // Byte can be any single-byte type, e.g. char or uint8_t
+    template <typename Byte>
+    constexpr void Update(const Byte* byteStream, size_t sizeInBytes)
+    {
+        static_assert(sizeof(Byte) == 1);
+        totalBytes += sizeInBytes;
+
+        // Complete a partial block left over from the previous update
+        if (bufferSize > 0)
+        {
+            const size_t bytesToCopy = std::min(buffer.size() - bufferSize, sizeInBytes);
+            std::copy(byteStream, byteStream + bytesToCopy, buffer.begin() + bufferSize);
+            bufferSize += bytesToCopy;
+            byteStream += bytesToCopy;
+            sizeInBytes -= bytesToCopy;
+            if (bufferSize < buffer.size())
+                return;
+            ProcessBlock(&buffer[0]);
+            bufferSize = 0;
+        }
+
+        // All the full 512-bit blocks can be processed immediately in streaming fashion, straight from the caller's memory
+        for (; sizeInBytes >= buffer.size(); byteStream += buffer.size(), sizeInBytes -= buffer.size())
+            ProcessBlock(byteStream);
+
+        std::copy(byteStream, byteStream + sizeInBytes, buffer.begin());
+        bufferSize = sizeInBytes;
+    }
+
+    constexpr Hash Finalize()
+    {
+        // Add the one bit after the message data, then k zero bits where l + 1 + k = 448 (mod 512)
+        buffer[bufferSize++] = 0x80;
+        if (bufferSize > 56)
+        {
+            std::fill(buffer.begin() + bufferSize, buffer.end(), 0);
+            ProcessBlock(&buffer[0]);
+            bufferSize = 0;
+        }
+        std::fill(buffer.begin() + bufferSize, buffer.begin() + 56, 0);
+
+        // Add the message size in bits as a big-endian 64-bit integer
+        const uint64_t messageSizeInBits = totalBytes << 3;
+        for (size_t i = 0; i < 8; ++i)
+            buffer[56 + i] = static_cast<unsigned char>(messageSizeInBits >> (56 - 8 * i));
+        ProcessBlock(&buffer[0]);
+
+        return H;
+    }
+
+private:
+    template <typename Byte>
+    constexpr void ProcessBlock(const Byte* block)
+    {
+        // The SHA-256 spec expects words to be organized in big endian format, so e.g. the byte stream "abcd" becomes 0x61626364.
+        // Loading byte by byte means the block needn't be aligned, and compilers turn this into a load and byte swap.
+        auto byte = [](Byte b) { return uint32_t(static_cast<unsigned char>(b)); };
+        std::array<uint32_t, 16> M = {};
+        for (size_t i = 0; i < M.size(); ++i, block += 4)
+            M[i] = (byte(block[0]) << 24) | (byte(block[1]) << 16) | (byte(block[2]) << 8) | byte(block[3]);
+        Detail::Process16WordBlock(&M[0], W, H);
+    }
+
+    Hash H;
+    Detail::Schedule W;
+    std::array<unsigned char, 64> buffer;
+    size_t bufferSize;
+    uint64_t totalBytes;
+};
+
+constexpr Hash Compute(const unsigned char* byteStream, size_t sizeInBytes)
+{
+    Hasher hasher;
+    hasher.Update(byteStream, sizeInBytes);
+    return hasher.Finalize();
+}
+
+namespace Detail
+{
+    // Feed the bytes of a range to the hasher: contiguous single bytes straight from memory, contiguous wider elements
+    // as their object bytes (not in constant expressions), and anything else one element at a time
+    template <typename Iter>
+    constexpr void UpdateRange(Hasher& hasher, Iter begin, Iter end)
+    {
+        using Element = std::remove_cvref_t<decltype(*begin)>;
+        if constexpr (std::contiguous_iterator<Iter> && sizeof(Element) == 1)
+            hasher.Update(std::to_address(begin), static_cast<size_t>(end - begin));
+        else if constexpr (std::contiguous_iterator<Iter>)
+            hasher.Update(reinterpret_cast<const unsigned char*>(std::to_address(begin)), static_cast<size_t>(end - begin) * sizeof(Element));
+        else
+        {
+            for (; begin != end; ++begin)
+            {
+                const auto bytes = std::bit_cast<std::array<unsigned char, sizeof(Element)>>(static_cast<Element>(*begin));
+                hasher.Update(&bytes[0], bytes.size());
+            }
+        }
+    }
+}
+
+template <typename Iter> constexpr Hash Compute(Iter begin, Iter end)
+{
+    Hasher hasher;
+    Detail::UpdateRange(hasher, begin, end);
+    return hasher.Finalize();
+}
+
+constexpr Hash Compute(std::span<const std::span<const unsigned char>> pieces)
+{
+    Hasher hasher;
+    for (const auto& piece : pieces)
+        hasher.Update(piece.data(), piece.size());
+    return hasher.Finalize();
+}
+
+constexpr Hash Compute(std::initializer_list<std::span<const unsigned char>> pieces)
+{
+    return Compute(std::span<const std::span<const unsigned char>>(pieces.begin(), pieces.size()));
+}
+
+namespace Detail
+{
+    // The hash value after the block SHA256(tag) || SHA256(tag).
+    // The digest words are already the big-endian message words, so there is no need to go through bytes.
+    template <TagString tag>
+    constexpr Hash TagMidstate()
+    {
+        const Hash tagHash = Compute(tag.chars, tag.chars + tag.size());
+        std::array<uint32_t, 16> M = {};
+        std::copy(tagHash.begin(), tagHash.end(), M.begin());
+        std::copy(tagHash.begin(), tagHash.end(), M.begin() + 8);
+
+        Hash H = s_initialHash;
+        Schedule W = {};
+        Process16WordBlock(&M[0], W, H);
+        return H;
     }
+
+    template <TagString tag>
+    constexpr Hash s_tagMidstate = TagMidstate<tag>();
 }
 
-inline Hash Compute(const unsigned char* byteStream, size_t sizeInBytes)
+template <TagString tag> constexpr Hasher TaggedHasher()
 {
-    using namespace Detail;
-
-    Schedule W; // Local state
-    Hash H = s_initialHash;
-    size_t bytesProcessed = 0;
-    std::array<uint32_t, 32> localWords;
-    constexpr size_t wordsPerBlock = 16;
-    constexpr size_t bytesPerBlock = wordsPerBlock * sizeof(uint32_t);
-
-    // All the full 512-bit blocks can be processed immediately in streaming fashion
-    while (sizeInBytes - bytesProcessed >= bytesPerBlock)
-    {
-        // The SHA-256 spec expects words to be organized in big endian format,
-        // so here we convert the byte stream appropriately so that e.g. the byte stream "abcd" will end up as 0x61626364
-        const uint32_t* pSrcWords = reinterpret_cast<const uint32_t*>(byteStream + bytesProcessed);
-        std::transform(pSrcWords, pSrcWords + wordsPerBlock, &localWords[0], [](uint32_t x) { return ReverseEndianWord(x); });
-        Process16WordBlock(&localWords[0], W, H);
-        bytesProcessed += bytesPerBlock;
-    }
-
-    // Initialize blocks to zero bits
-    std::fill(localWords.begin(), localWords.end(), 0);
-    uint8_t* localBytes = reinterpret_cast<uint8_t*>(&localWords[0]);
-    const uint32_t bytesRemaining = static_cast<uint32_t>(sizeInBytes - bytesProcessed);
-
-    // Copy the message data while reversing endian-ness
-    for (uint32_t iByte = 0; iByte < bytesRemaining; ++iByte)
-        localBytes[ReverseEndianByteIndex(iByte)] = byteStream[bytesProcessed + iByte];
-
-     // Add the one bit after lBits of message data
-    localBytes[ReverseEndianByteIndex(bytesRemaining)] = 0x80;
-
-    // Add the message size in bits
-    const uint32_t lBits = bytesRemaining << 3; // l bits of the message remaining
-    const uint32_t zeroBits = lBits <= 447 ? 447 - lBits : 512 + 447 - lBits; // k zero bits where l + 1 + k = 448 (mod 512)
-    const uint32_t messageSizeWordPos = (lBits + 1 + zeroBits) >> 5; // The message size goes after the zero padding bits
-    const uint64_t messageSizeInBits = sizeInBytes << 3;
-    const uint32_t messageSizeLoWord = static_cast<uint32_t>(messageSizeInBits);
-    const uint32_t messageSizeHiWord = static_cast<uint32_t>(messageSizeInBits >> 32);
-    localWords[messageSizeWordPos] = messageSizeHiWord;
-    localWords[messageSizeWordPos + 1] = messageSizeLoWord;
-
-    // Process the remaining blocks
-    Process16WordBlock(&localWords[0], W, H);
-    if (lBits >= 448) // messageSizeWordPos + 1 >= 16
-        Process16WordBlock(&localWords[16], W, H);
-
-    // Return the final hash value
-    return H;
+    return Hasher(Detail::s_tagMidstate<tag>, 64);
 }
 
-template <typename Iter> Hash Compute(Iter begin, Iter end)
+template <TagString tag> constexpr Hash TaggedHash(const unsigned char* byteStream, size_t sizeInBytes)
 {
-    const auto diff = end - begin;
-    const size_t bytes = diff * sizeof(std::remove_reference_t<decltype(*begin)>);
-    return Compute(bytes == 0 ? nullptr : reinterpret_cast<const unsigned char*>(&*begin), bytes);
+    auto hasher = TaggedHasher<tag>();
+    hasher.Update(byteStream, sizeInBytes);
+    return hasher.Finalize();
+}
+
+template <TagString tag, typename Iter> constexpr Hash TaggedHash(Iter begin, Iter end)
+{
+    auto hasher = TaggedHasher<tag>();
+    Detail::UpdateRange(hasher, begin, end);
+    return hasher.Finalize();
+}
+
+namespace Detail
+{
+    // Number of 64-byte blocks after padding: the message, the 0x80 byte and the 64-bit length
+    inline size_t BlockCount(size_t sizeInBytes)
+    {
+        return (sizeInBytes + 8) / 64 + 1;
+    }
+
+    // The words of one padded block of the message
+    inline std::array<uint32_t, 16> PaddedBlock(std::span<const unsigned char> message, size_t blockIndex)
+    {
+        std::array<uint8_t, 64> bytes = {};
+        const size_t begin = blockIndex * 64;
+        if (begin < message.size())
+        {
+            const size_t count = std::min<size_t>(64, message.size() - begin);
+            std::copy(message.begin() + begin, message.begin() + begin + count, bytes.begin());
+        }
+        if (message.size() >= begin && message.size() < begin + 64)
+            bytes[message.size() - begin] = 0x80;
+        if (blockIndex + 1 == BlockCount(message.size()))
+        {
+            const uint64_t messageSizeInBits = uint64_t(message.size()) << 3;
+            for (size_t i = 0; i < 8; ++i)
+                bytes[56 + i] = static_cast<uint8_t>(messageSizeInBits >> (56 - 8 * i));
+        }
+
+        std::array<uint32_t, 16> M;
+        for (size_t k = 0; k < 16; ++k)
+            M[k] = (uint32_t(bytes[4 * k]) << 24) | (uint32_t(bytes[4 * k + 1]) << 16) | (uint32_t(bytes[4 * k + 2]) << 8) | bytes[4 * k + 3];
+        return M;
+    }
+
+    // Hash up to LaneCount messages in lanes
+    inline void ComputeLanes(std::span<const std::span<const unsigned char>> messages, std::span<Hash> hashes)
+    {
+        using Word = Lanes<LaneCount>;
+
+        std::array<size_t, LaneCount> blockCounts = {};
+        size_t maxBlockCount = 0;
+        for (size_t lane = 0; lane < messages.size(); ++lane)
+        {
+            blockCounts[lane] = BlockCount(messages[lane].size());
+            maxBlockCount = std::max(maxBlockCount, blockCounts[lane]);
+        }
+
+        std::array<Word, 8> H;
+        for (size_t i = 0; i < 8; ++i)
+            H[i] = s_initialHash[i];
+        std::array<Word, 64> W;
+        for (size_t block = 0; block < maxBlockCount; ++block)
+        {
+            std::array<Word, 16> M;
+            for (size_t lane = 0; lane < messages.size(); ++lane)
+            {
+                if (block >= blockCounts[lane])
+                    continue;
+                const auto words = PaddedBlock(messages[lane], block);
+                for (size_t k = 0; k < 16; ++k)
+                    M[k].Set(lane, words[k]);
+            }
+
+            auto next = H;
+            Process16WordBlock(&M[0], W, next);
+            for (size_t lane = 0; lane < LaneCount; ++lane)
+                if (lane >= messages.size() || block < blockCounts[lane]) // Finished lanes keep their hash
+                    for (size_t i = 0; i < 8; ++i)
+                        H[i].Set(lane, next[i][lane]);
+        }
+
+        for (size_t lane = 0; lane < messages.size(); ++lane)
+            for (size_t i = 0; i < 8; ++i)
+                hashes[lane][i] = H[i][lane];
+    }
+}
+
+inline void ComputeBatch(std::span<const std::span<const unsigned char>> messages, std::span<Hash> hashes)
+{
+    if (hashes.size() != messages.size())
+        throw std::invalid_argument("Output span must match the number of messages");
+    for (size_t i = 0; i < messages.size(); i += LaneCount)
+    {
+        const size_t count = std::min(LaneCount, messages.size() - i);
+        Detail::ComputeLanes(messages.subspan(i, count), hashes.subspan(i, count));
+    }
 }
 
 }
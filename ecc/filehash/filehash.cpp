@@ -0,0 +1,66 @@
+// Hash files of any size with bounded memory, reporting the throughput.
+// Usage: filehash [--sha256 | --ripemd160] [--mapped | --buffered] file...
+
+#include "SHA256.h"
+#include "RIPEMD160.h"
+#include "FileHash.h"
+
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+// SHA-256 digests are written as big-endian words, RIPEMD-160 digests as little-endian words
+template <typename Hasher>
+void HashFile(const std::string& path, FileHash::Method method, bool bigEndianWords)
+{
+    FileHash::Statistics statistics;
+    const auto hash = FileHash::Compute<Hasher>(path, method, &statistics);
+    for (auto word : hash)
+        for (int i = 0; i < 4; ++i)
+            std::cout << std::hex << std::setw(2) << std::setfill('0') << ((word >> (bigEndianWords ? 24 - 8 * i : 8 * i)) & 0xFF);
+    std::cout << std::dec << "  " << path << "  (" << statistics.bytes << " bytes, "
+              << std::fixed << std::setprecision(1) << statistics.MegabytesPerSecond() << " MB/s)" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    bool ripemd160 = false;
+    auto method = FileHash::Method::Automatic;
+    int filesHashed = 0, result = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--sha256")
+            ripemd160 = false;
+        else if (arg == "--ripemd160")
+            ripemd160 = true;
+        else if (arg == "--mapped")
+            method = FileHash::Method::Mapped;
+        else if (arg == "--buffered")
+            method = FileHash::Method::Buffered;
+        else
+        {
+            try
+            {
+                if (ripemd160)
+                    HashFile<RIPEMD160::Hasher>(arg, method, false);
+                else
+                    HashFile<SHA256::Hasher>(arg, method, true);
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "filehash: " << e.what() << std::endl;
+                result = 1;
+            }
+            ++filesHashed;
+        }
+    }
+
+    if (filesHashed == 0)
+    {
+        std::cerr << "Usage: filehash [--sha256 | --ripemd160] [--mapped | --buffered] file..." << std::endl;
+        return 2;
+    }
+    return result;
+}